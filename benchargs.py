@@ -32,12 +32,14 @@ bench_args = {
   'mm-se' : {'args': '-n 4096', 'runs': 10},
   'mm-fj' : {'args': '-n 4096', 'runs': 10},
   'mm-sf' : {'args': '-n 4096', 'runs': 10},
+  'mm-sf-single' : {'args': '-n 4096', 'runs': 10},
   'smm-se' : {'args': '-n 4096', 'runs': 10},
   'smm-fj' : {'args': '-n 4096', 'runs': 10},
   'smm-sf' : {'args': '-n 4096', 'runs': 10},
   'sort-se' : {'args': '-n 100000000', 'runs': 10},
   'sort-fj' : {'args': '-n 100000000', 'runs': 10},
   'sort-sf' : {'args': '-n 100000000', 'runs': 10},
+  'sort-sf-single' : {'args': '-n 100000000', 'runs': 10},
   'hw-se' : {'args': '$(find futurerd-bench -name test.avi) 104 {}', 'runs': 10},
   'hw-fj' : {'args': '$(find futurerd-bench -name test.avi) 104 {}', 'runs': 10},
   'hw-sf' : {'args': '$(find futurerd-bench -name test.avi) 104 {}', 'runs': 10},
@@ -46,14 +48,17 @@ bench_args = {
   'lcs-fj' : {'args': '-n 32768 -b 512', 'runs': 10},
   'lcs-sf' : {'args': '-n 32768 -b 512', 'runs': 10},
   'lcs-gf' : {'args': '-n 32768 -b 512', 'runs': 10},
+  'lcs-gf-padded' : {'args': '-n 32768 -b 512', 'runs': 10},
   'lcs-se2' : {'args': '-n 32768 -b 1024', 'runs': 10},
   'lcs-fj2' : {'args': '-n 32768 -b 1024', 'runs': 10},
   'lcs-sf2' : {'args': '-n 32768 -b 1024', 'runs': 10},
   'lcs-gf2' : {'args': '-n 32768 -b 1024', 'runs': 10},
+  'lcs-gf-padded2' : {'args': '-n 32768 -b 1024', 'runs': 10},
   'sw-se' : {'args': '-n 2048 -b 32', 'runs': 10},
   'sw-fj' : {'args': '-n 2048 -b 32', 'runs': 10},
   'sw-sf' : {'args': '-n 2048 -b 32', 'runs': 10},
   'sw-gf' : {'args': '-n 2048 -b 32', 'runs': 10},
+  'sw-gf-padded' : {'args': '-n 2048 -b 32', 'runs': 10},
   'bst-se' : {'args': '-s1 8000000 -s2 4000000', 'runs': 10},
   'bst-fj' : {'args': '-s1 8000000 -s2 4000000', 'runs': 10},
   'bst-gf' : {'args': '-s1 8000000 -s2 4000000', 'runs': 10},
@@ -64,4 +69,15 @@ bench_args = {
   'fib-fj' : {'args': '42', 'runs': 10},
   'fib-sf' : {'args': '42', 'runs': 10},
   'fib-sf-stack' : {'args': '42', 'runs': 10},
+  'fib-sf-template' : {'args': '42', 'runs': 10},
+  'fib-sf-single' : {'args': '42', 'runs': 10},
+  'fib-sf-lazy' : {'args': '42', 'runs': 10},
+  'stream-sf' : {'args': '-n 20000 -rate 20000', 'runs': 10},
+  'stream-sf-join' : {'args': '-n 20000 -rate 20000', 'runs': 10},
+  'stream-fj' : {'args': '-n 20000 -rate 20000', 'runs': 10},
+  'stream-std' : {'args': '-n 20000 -rate 20000', 'runs': 10},
+  'stream-sf2' : {'args': '-n 5000 -rate 1000', 'runs': 10},
+  'stream-sf-join2' : {'args': '-n 5000 -rate 1000', 'runs': 10},
+  'stream-fj2' : {'args': '-n 5000 -rate 1000', 'runs': 10},
+  'stream-std2' : {'args': '-n 5000 -rate 1000', 'runs': 10},
 }
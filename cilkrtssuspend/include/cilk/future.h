@@ -2,47 +2,67 @@
 #define __CILK__FUTURE_H__
 
 #include <assert.h>
-#include <functional>
+#include <stddef.h>
+#include <stdlib.h>
+#include <exception>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <internal/abi.h>
 #include <pthread.h>
 #include "handcomp-macros.h"
 
-extern void __spawn_future_helper_helper(std::function<void*(void)>);
-
 extern "C" {
 void __cilkrts_insert_deque_into_list(__cilkrts_deque_link *volatile *list);
+void __cilkrts_insert_link_into_list(__cilkrts_deque_link *volatile *list,
+                                     __cilkrts_deque_link *link);
 }
 
 namespace cilk {
 
+// Called by put() once the future is marked ready and num_deques
+// waiters were counted in. Returns the first waiter, which the caller
+// resumes directly. The rest of the list is handed to the runtime as a
+// chain: only the second waiter is made resumable here, and whoever
+// takes it passes the remainder on in two halves, so put() costs O(1)
+// no matter how many strands are waiting. A waiter that is a when_all/when_any join
+// rather than a deque is left to the runtime.
+static inline void* __attribute__((always_inline))
+__take_waiters(__cilkrts_deque_link *head, int num_deques) {
+    if (num_deques <= 0) return NULL;
+
+    __cilkrts_deque_link *node = head;
+    while (!node->next);
+    node = node->next;
+    if (__builtin_expect((uintptr_t) node->d & __CILKRTS_JOIN_TAG, 0))
+        return __cilkrts_take_waiter_links(node, num_deques);
+    void *ret = node->d;
+
+    if (num_deques > 1) {
+        // Must read this before ret is resumed and reuses its link
+        while (!node->next);
+        __cilkrts_make_resumable_links(node->next, num_deques - 1);
+    }
+
+    return ret;
+}
+
 #define reuse_future(T,fut, loc,func,args...)  \
   { \
-  auto functor = std::bind(func, ##args);  \
   fut = new (loc) cilk::future<T>();  \
-  auto __temp_fut = fut; \
-  __spawn_future_helper_helper([__temp_fut,functor]() -> void* { \
-    return __temp_fut->put(functor()); \
-  }); \
+  cilk::spawn_future(fut, func, ##args); \
   }
 
 #define reuse_future_inplace(T,loc,func,args...)  \
   { \
-  auto functor = std::bind(func, ##args);  \
-  new (loc) cilk::future<T>();  \
-  auto __temp_fut = loc; \
-  __spawn_future_helper_helper([__temp_fut,functor]() -> void* { \
-    return __temp_fut->put(functor()); \
-  }); \
+  cilk::spawn_future(new (loc) cilk::future<T>(), func, ##args); \
   }
 
 #define use_future_inplace(T,fut,func,args...)  \
   { \
-  auto functor = std::bind(func, ##args);  \
-  auto __temp_fut = fut; \
-  __spawn_future_helper_helper([__temp_fut,functor]() -> void* { \
-    return __temp_fut->put(functor()); \
-  }); \
+  cilk::spawn_future<T>(fut, func, ##args); \
   }
 
 
@@ -50,43 +70,246 @@ namespace cilk {
 
 #define cilk_future_create(T,fut,func,args...) \
   { \
-  auto functor = std::bind(func, ##args);  \
   fut = new cilk::future<T>();  \
-  auto __temp_fut = fut; \
-  __spawn_future_helper_helper([__temp_fut,functor]() -> void* { \
-    return __temp_fut->put(functor()); \
-  }); \
+  cilk::spawn_future(fut, func, ##args); \
   }
 
 
 #define cilk_future_create__stack(T,fut,func,args...)\
   cilk::future<T> fut;\
+  cilk::spawn_future(&fut, func, ##args);
+
+// A future tied to a cilk::cancel_token; see cilk::cancel_token.
+#define cilk_future_create__cancellable(T,fut,token,func,args...) \
+  { \
+    fut = new cilk::future<T>(); \
+    cilk::spawn_future(fut, token, func, ##args); \
+  }
+
+// A future with a priority hint; see future<T>::set_priority.
+#define cilk_future_create__priority(T,fut,prio,func,args...) \
+  { \
+    fut = new cilk::future<T>(); \
+    fut->set_priority(prio); \
+    cilk::spawn_future(fut, func, ##args); \
+  }
+
+// Lazy futures run their body on the creator's stack, as an ordinary
+// cilk_spawn, instead of switching to a fresh fiber. A new fiber only
+// comes into play if the continuation is actually stolen (the thief
+// gets one, as for any steal) or the body blocks in get() (the worker
+// moves on to a new deque, as for any suspension), so creating one
+// costs about as much as a spawn.
+//
+// The catch is that the body's frames sit below the creator's, so the
+// creating function syncs with the body before it returns, just like
+// with cilk_spawn. The body must therefore not wait on anything that
+// the creator only produces after it returns, and a __stack__lazy
+// future must be declared at function scope, where it outlives that
+// sync. cilk_future_create, cilk_future_create__stack and
+// cilk::spawn_future are never lazy; call sites opt in by name.
+#define cilk_future_create__lazy(T,fut,func,args...) \
   { \
-    auto functor = std::bind(func, ##args); \
-    __spawn_future_helper_helper([&fut,functor]() -> void* { \
-      return fut.put(functor()); \
-    }); \
+  fut = new cilk::future<T>();  \
+  _Cilk_spawn cilk::__lazy_future_body(fut, func, ##args); \
   }
 
+#define cilk_future_create__stack__lazy(T,fut,func,args...)\
+  cilk::future<T> fut;\
+  _Cilk_spawn cilk::__lazy_future_body(&fut, func, ##args);
+
+// A stack future that will be touched exactly once; see single_future
+// below.
+#define cilk_future_create__stack__single(T,fut,func,args...)\
+  cilk::single_future<T> fut;\
+  cilk::spawn_future(&fut, func, ##args);
+
+// A continuation attached to a future with then(). run() starts it
+// and frees it.
+struct __future_cont {
+  __future_cont *next;
+  void (*run)(__future_cont *self);
+};
+
+// Or'd into a future's waiter count once a continuation is attached,
+// so that put() only looks for continuations when there are some.
+static const int __future_then_flag = 1 << 30;
+
+// For a future that is reset or destroyed: gives back the links that
+// when_any joins left in its waiter list, if it was never put (see
+// __cilkrts_drop_waiter_links). Nothing else may be waiting on it.
+static inline void __attribute__((always_inline))
+__drop_waiters(__cilkrts_deque_link *head, int state) {
+  int n = state & ~__future_then_flag;
+  if (__builtin_expect(state > 0 && n > 0, 0)) {
+    while (!head->next);
+    __cilkrts_drop_waiter_links(head->next, n);
+  }
+}
+
+static inline __future_cont* __attribute__((always_inline))
+__conts_done() {
+  return reinterpret_cast<__future_cont*>(1);
+}
+
+// Takes the continuations attached to a future that is now ready and
+// starts them in the order they were attached. Whoever sees both the
+// flag and the future ready calls this; the exchange makes sure each
+// continuation runs once, and any attached later runs right away.
+inline void __attribute__((noinline))
+__run_continuations(__future_cont *volatile *conts) {
+  __future_cont *c = __atomic_exchange_n(conts, __conts_done(), __ATOMIC_SEQ_CST);
+  if (c == __conts_done()) return;
+
+  __future_cont *ordered = NULL;
+  while (c) {
+    __future_cont *next = c->next;
+    c->next = ordered;
+    ordered = c;
+    c = next;
+  }
+  while (ordered) {
+    __future_cont *next = ordered->next;
+    ordered->run(ordered);
+    ordered = next;
+  }
+}
+
+static inline void
+__attach_continuation(volatile int *count, __future_cont *volatile *conts,
+                      __future_cont *c) {
+  __future_cont *head = *conts;
+  do {
+    if (head == __conts_done()) {
+      c->run(c);
+      return;
+    }
+    c->next = head;
+  } while (!__atomic_compare_exchange_n(conts, &head, c, false,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+  // If the put came first, it did not see the flag and left the
+  // continuations to us.
+  if (__atomic_fetch_or(count, __future_then_flag, __ATOMIC_SEQ_CST) < 0)
+    __run_continuations(conts);
+}
+
+template<typename T, typename F>
+struct __then_result {
+  typedef typename std::decay<
+    typename std::result_of<F&(T&)>::type>::type type;
+};
+
+template<typename F>
+struct __then_result<void, F> {
+  typedef typename std::decay<typename std::result_of<F&()>::type>::type type;
+};
+
+template<typename T, typename F>
+using __then_result_t = typename __then_result<T, F>::type;
+
+template<typename T>
+class future;
+
+template<typename T, typename F>
+future<__then_result_t<T, F>>* __then(future<T> *fut, F &&func);
+
+// What get() throws for a future whose cancel_token was cancelled
+// before it was ready, and what a body throws to finish early.
+class future_cancelled : public std::exception {
+public:
+  const char* what() const noexcept { return "cilk::future_cancelled"; }
+};
+
+class cancel_token;
+
+template<typename Fut>
+void __wait_cancellable(Fut *fut, cancel_token *token);
+
+// The exception a future's body threw, if it did, for get() to
+// rethrow. It is kept on the heap so that a future that never fails
+// pays only for a null pointer.
+class __future_exception {
+private:
+  std::exception_ptr *m_exception;
+
+public:
+  __future_exception() : m_exception(NULL) {}
+  ~__future_exception() { clear(); }
+
+  // Futures are only ever copied fresh (cilk::future<int> f =
+  // cilk::future<int>()), so a copy starts out empty.
+  __future_exception(const __future_exception&) : m_exception(NULL) {}
+  __future_exception& operator=(const __future_exception&) {
+    clear();
+    return *this;
+  }
+
+  void set(std::exception_ptr e) {
+    m_exception = new std::exception_ptr(std::move(e));
+  }
+
+  bool __attribute__((always_inline)) failed() const {
+    return __builtin_expect(m_exception != NULL, 0);
+  }
+
+  void __attribute__((always_inline)) rethrow_if_failed() const {
+    if (failed()) std::rethrow_exception(*m_exception);
+  }
+
+  void clear() {
+    delete m_exception;
+    m_exception = NULL;
+  }
+};
+
 template<typename T>
 class future {
 private:
-  volatile T m_result;
+  // The result is constructed in place when the future is put, so T
+  // may be move-only and need not be default constructible.
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
 
   __cilkrts_deque_link head = {
     .d = NULL, .next = NULL
   };
   __cilkrts_deque_link *volatile tail = &head;
   volatile int m_num_suspended_deques;
+  __cilkrts_worker *m_producer = NULL;
+  __future_cont *volatile m_conts = NULL;
+  __future_exception m_exception;
+  cancel_token *m_token = NULL;
+  int m_priority = 0;
 
   void __attribute__((always_inline)) suspend_deque() {
     int ticket = __atomic_fetch_add(&m_num_suspended_deques, 1, __ATOMIC_SEQ_CST);
     if (ticket >= 0) {
         __cilkrts_insert_deque_into_list(&tail);
         __asm__ volatile ("" ::: "memory");
-        __cilkrts_suspend_deque();
+        __cilkrts_suspend_deque_at(m_producer, m_priority);
     }
   }
+
+  T& __attribute__((always_inline)) value() {
+    return *reinterpret_cast<T*>(&m_storage);
+  }
+
+  void __attribute__((always_inline)) destroy_value() {
+    if (!std::is_trivially_destructible<T>::value && ready()
+        && !m_exception.failed())
+      value().~T();
+  }
+
+  // Marks the future ready and returns a waiter to resume, as put()
+  // does.
+  void* __attribute__((always_inline)) mark_ready() {
+    int num_deques = __atomic_fetch_add(&m_num_suspended_deques, INT32_MIN, __ATOMIC_SEQ_CST);
+
+    void *d = __take_waiters(&head, num_deques & ~__future_then_flag);
+    if (__builtin_expect(num_deques & __future_then_flag, 0))
+      __run_continuations(&m_conts);
+    return d;
+  }
   
 public:
 
@@ -96,52 +319,154 @@ public:
   };
 
   ~future() {
+    __drop_waiters(&head, m_num_suspended_deques);
+    destroy_value();
   }
 
   inline void reset() {
+    __drop_waiters(&head, m_num_suspended_deques);
+    destroy_value();
+    m_exception.clear();
     m_num_suspended_deques = 0;
     tail = &head;
     head.next = NULL;
+    m_producer = NULL;
+    m_conts = NULL;
+    m_token = NULL;
+    m_priority = 0;
+  }
+
+  // Remembers the worker the body started on, for get() to help.
+  // Called by spawn_future.
+  void __attribute__((always_inline)) __set_producer(__cilkrts_worker *w) {
+    m_producer = w;
   }
 
-  void* __attribute__((always_inline)) put(T result) {
-    m_result = result;
+  // Ties the future to token; see spawn_future(fut, token, ...).
+  void __set_token(cancel_token *token) {
+    m_token = token;
+  }
+
+  // A hint that the future is on a latency-critical path. Once it is
+  // put, deques that suspended waiting for it are resumed ahead of
+  // ordinary ones (see CILK_PRIORITY_BURST); 0, the default, is
+  // ordinary. Set it before the future is spawned.
+  void set_priority(int priority) {
+    m_priority = priority;
+  }
+
+  // Puts link in the waiter list unless the future is ready, in which
+  // case it returns false. Called by when_all and when_any.
+  bool __add_waiter(__cilkrts_deque_link *link) {
+    if (__atomic_fetch_add(&m_num_suspended_deques, 1, __ATOMIC_SEQ_CST) < 0)
+      return false;
+    __cilkrts_insert_link_into_list(&tail, link);
+    return true;
+  }
+
+  // Starts c once the future is ready, or now if it already is.
+  void __attach(__future_cont *c) {
+    __attach_continuation(&m_num_suspended_deques, &m_conts, c);
+  }
+
+  // Returns a new future for func(get()). Nothing waits for this one:
+  // the put() that makes it ready spawns func as a future itself (or
+  // then() does, if it already is), so a pipeline can chain its stages
+  // without suspending anything in between. func gets the result by
+  // reference, so this future must outlive it. Any number of
+  // continuations may be attached; they start in order. The caller
+  // owns (and deletes) the returned future.
+  template<typename F>
+  future<__then_result_t<T, F>>* then(F &&func) {
+    return __then(this, std::forward<F>(func));
+  }
+
+  // Constructs the result from args, in place, and marks the future
+  // ready. Returns a waiter to resume, as put() does.
+  template<typename... Args>
+  void* __attribute__((always_inline)) emplace(Args&&... args) {
+    new (&m_storage) T(std::forward<Args>(args)...);
     __asm__ volatile ("" ::: "memory");
 
-    int num_deques = __atomic_fetch_add(&m_num_suspended_deques, INT32_MIN, __ATOMIC_SEQ_CST);
+    return mark_ready();
+  }
 
-    void *ret = NULL;
+  // Stores e instead of a result and marks the future ready, resuming
+  // waiters just as put() does; get() rethrows e in each of them.
+  void* set_exception(std::exception_ptr e) {
+    m_exception.set(std::move(e));
+    return mark_ready();
+  }
 
-    if (num_deques > 0) {
-        __cilkrts_deque_link *node = &head;
-        while (!node->next);
-        node = node->next;
-        num_deques--;
-        ret = node->d;
-        while (num_deques) {
-            while (!node->next);
-            node = node->next;
-            num_deques--;
-            __cilkrts_make_resumable(node->d);
-        }
-    }
+  // The two halves of emplace() and set_exception(), for the bodies
+  // spawn_future runs: the outcome is stored while the body's
+  // exceptions are caught, and made visible (which may start
+  // continuations) only once that is over.
+  template<typename... Args>
+  void __attribute__((always_inline)) __store(Args&&... args) {
+    new (&m_storage) T(std::forward<Args>(args)...);
+  }
 
-    return ret;
-  };
+  void __store_exception(std::exception_ptr e) {
+    m_exception.set(std::move(e));
+  }
+
+  void* __attribute__((always_inline)) __complete() {
+    __asm__ volatile ("" ::: "memory");
+    return mark_ready();
+  }
+
+  void* __attribute__((always_inline)) put(const T &result) {
+    return emplace(result);
+  }
+
+  void* __attribute__((always_inline)) put(T &&result) {
+    return emplace(std::move(result));
+  }
 
   bool __attribute__((always_inline)) ready() {
     // If the put has replaced the value with INT32_MIN,
     // then the value is ready.
-    return (m_num_suspended_deques < 0);
+    return (__atomic_load_n(&m_num_suspended_deques, __ATOMIC_ACQUIRE) < 0);
   } 
 
-  T __attribute__((always_inline)) get() {
+  // Returns the result in place; it lives as long as the future (or
+  // until reset()). Every caller gets the same object, so the only
+  // reader may std::move it out instead of copying.
+  // If the future has a cancel_token that is cancelled first, throws
+  // future_cancelled instead.
+  T& __attribute__((always_inline)) get() {
     if (!this->ready()) {
-      suspend_deque();
+      if (__builtin_expect(m_token != NULL, 0))
+        __wait_cancellable(this, m_token);
+      else if (__cilkrts_may_suspend(&m_num_suspended_deques))
+        suspend_deque();
     }
 
     assert(ready());
-    return m_result;
+    m_exception.rethrow_if_failed();
+    return value();
+  }
+
+  // Returns the result in place, as get() does, if the future is
+  // ready (rethrowing what its body threw, if anything); otherwise
+  // returns NULL without waiting. Nothing is copied, so T may be
+  // move-only.
+  T* try_get() {
+    if (!this->ready()) return NULL;
+    return &get();
+  }
+
+  // get() for a future that is likely to be put soon: spins for up to
+  // spins pauses (CILK_GET_SPINS if negative) before suspending, since
+  // a short wait is much cheaper than suspending and resuming the
+  // deque. It runs no other work while it spins. After that it is get()
+  // as usual; with CILK_HELP_PRODUCER, the worker looks for work on the
+  // producer once the deque has suspended.
+  T& get_or_spin(int spins = -1) {
+    if (!this->ready())
+      __cilkrts_spin_until_ready(&m_num_suspended_deques, spins);
+    return get();
   }
 }; // class future
 
@@ -156,13 +481,18 @@ private:
   };
   __cilkrts_deque_link *volatile tail = &head;
   volatile int m_num_suspended_deques;
+  __cilkrts_worker *m_producer = NULL;
+  __future_cont *volatile m_conts = NULL;
+  __future_exception m_exception;
+  cancel_token *m_token = NULL;
+  int m_priority = 0;
 
   void __attribute__((always_inline)) suspend_deque() {
     int ticket = __atomic_fetch_add(&m_num_suspended_deques, 1, __ATOMIC_SEQ_CST);
     if (ticket >= 0) {
         __cilkrts_insert_deque_into_list(&tail);
         __asm__ volatile ("" ::: "memory");
-        __cilkrts_suspend_deque();
+        __cilkrts_suspend_deque_at(m_producer, m_priority);
     }
   }
   
@@ -174,52 +504,865 @@ public:
   };
 
   ~future() {
+    __drop_waiters(&head, m_num_suspended_deques);
   }
 
   inline void reset() {
+    __drop_waiters(&head, m_num_suspended_deques);
+    m_exception.clear();
     m_num_suspended_deques = 0;
     tail = &head;
     head.next = NULL;
+    m_producer = NULL;
+    m_conts = NULL;
+    m_token = NULL;
+    m_priority = 0;
+  }
+
+  // Remembers the worker the body started on, for get() to help.
+  // Called by spawn_future.
+  void __attribute__((always_inline)) __set_producer(__cilkrts_worker *w) {
+    m_producer = w;
+  }
+
+  // Ties the future to token; see spawn_future(fut, token, ...).
+  void __set_token(cancel_token *token) {
+    m_token = token;
+  }
+
+  // See future<T>::set_priority.
+  void set_priority(int priority) {
+    m_priority = priority;
+  }
+
+  // Puts link in the waiter list unless the future is ready, in which
+  // case it returns false. Called by when_all and when_any.
+  bool __add_waiter(__cilkrts_deque_link *link) {
+    if (__atomic_fetch_add(&m_num_suspended_deques, 1, __ATOMIC_SEQ_CST) < 0)
+      return false;
+    __cilkrts_insert_link_into_list(&tail, link);
+    return true;
+  }
+
+  // Starts c once the future is ready, or now if it already is.
+  void __attach(__future_cont *c) {
+    __attach_continuation(&m_num_suspended_deques, &m_conts, c);
+  }
+
+  // Returns a new future for func(), started once this one is put; see
+  // future<T>::then.
+  template<typename F>
+  future<__then_result_t<void, F>>* then(F &&func) {
+    return __then(this, std::forward<F>(func));
   }
 
   void* __attribute__((always_inline)) put(void) {
     int num_deques = __atomic_fetch_add(&m_num_suspended_deques, INT32_MIN, __ATOMIC_SEQ_CST);
     __asm__ volatile ("" ::: "memory");
 
-    void *ret = NULL;
+    void *d = __take_waiters(&head, num_deques & ~__future_then_flag);
+    if (__builtin_expect(num_deques & __future_then_flag, 0))
+      __run_continuations(&m_conts);
+    return d;
+  };
 
-    if (num_deques > 0) {
-        __cilkrts_deque_link *node = &head;
-        while (!node->next);
-        node = node->next;
-        num_deques--;
-        ret = node->d;
-        while (num_deques) {
-            while (!node->next);
-            node = node->next;
-            num_deques--;
-            __cilkrts_make_resumable(node->d);
-        }
-    }
+  // Marks the future failed with e; see future<T>::set_exception.
+  void* set_exception(std::exception_ptr e) {
+    m_exception.set(std::move(e));
+    return put();
+  }
 
-    return ret;
-  };
+  // See future<T>::__store.
+  void __attribute__((always_inline)) __store() {}
+
+  void __store_exception(std::exception_ptr e) {
+    m_exception.set(std::move(e));
+  }
+
+  void* __attribute__((always_inline)) __complete() {
+    return put();
+  }
 
   bool __attribute__((always_inline)) ready() {
     // If the put has replaced the value with INT32_MIN,
     // then the value is ready.
-    return (m_num_suspended_deques < 0);
+    return (__atomic_load_n(&m_num_suspended_deques, __ATOMIC_ACQUIRE) < 0);
   } 
 
   void __attribute__((always_inline)) get() {
     if (!this->ready()) {
-      suspend_deque();
+      if (__builtin_expect(m_token != NULL, 0))
+        __wait_cancellable(this, m_token);
+      else if (__cilkrts_may_suspend(&m_num_suspended_deques))
+        suspend_deque();
     }
 
     assert(ready());
+    m_exception.rethrow_if_failed();
+  }
+
+  // See future<T>::try_get.
+  bool try_get() {
+    if (!this->ready()) return false;
+    get();
+    return true;
+  }
+
+  // See future<T>::get_or_spin.
+  void get_or_spin(int spins = -1) {
+    if (!this->ready())
+      __cilkrts_spin_until_ready(&m_num_suspended_deques, spins);
+    get();
   }
 }; // class future<void>
 
+// Shared by the single_future specializations: the waiter slot and the
+// handshake on it.
+class __single_future_base {
+protected:
+  // NULL until get() blocks, then the waiting deque; __ready_tag() once
+  // the future has been put.
+  void *volatile m_waiter;
+  __cilkrts_worker *m_producer;
+  __future_exception m_exception;
+#ifndef NDEBUG
+  volatile int m_touches;
+#endif
+
+  static void* __attribute__((always_inline)) __ready_tag() {
+    return reinterpret_cast<void*>(1);
+  }
+
+  // Marks the future ready. Returns the waiting deque, if any, for the
+  // caller to resume.
+  void* __attribute__((always_inline)) mark_ready() {
+    return __atomic_exchange_n(&m_waiter, __ready_tag(), __ATOMIC_SEQ_CST);
+  }
+
+  void __attribute__((always_inline)) wait() {
+#ifndef NDEBUG
+    // Not atomic, so that checking costs next to nothing; two touches
+    // at the same time are caught at the CAS below instead.
+    assert(m_touches++ == 0 && "cilk::single_future touched more than once");
+#endif
+    if (!this->ready() && __cilkrts_may_suspend_until(&m_waiter, __ready_tag())) {
+      void *expected = NULL;
+      void *d = __cilkrts_get_deque();
+      // If the put beat us to the slot, the value is already there.
+      if (__atomic_compare_exchange_n(&m_waiter, &expected, d, false,
+                                      __ATOMIC_SEQ_CST, __ATOMIC_ACQUIRE))
+        __cilkrts_suspend_deque_on(m_producer);
+      assert(expected == NULL || expected == __ready_tag());
+    }
+    assert(ready());
+    m_exception.rethrow_if_failed();
+  }
+
+  // The spin of get_or_spin(); see future<T>::get_or_spin.
+  void spin(int spins) {
+    if (!this->ready())
+      __cilkrts_spin_until_ready_slot(&m_waiter, __ready_tag(), spins);
+  }
+
+  void __attribute__((always_inline)) reset_base() {
+    m_exception.clear();
+    m_waiter = NULL;
+    m_producer = NULL;
+#ifndef NDEBUG
+    m_touches = 0;
+#endif
+  }
+
+  __single_future_base() {
+    reset_base();
+  }
+
+public:
+  bool __attribute__((always_inline)) ready() {
+    return (__atomic_load_n(&m_waiter, __ATOMIC_ACQUIRE) == __ready_tag());
+  }
+
+  // Remembers the worker the body started on, for get() to help.
+  // Called by spawn_future.
+  void __attribute__((always_inline)) __set_producer(__cilkrts_worker *w) {
+    m_producer = w;
+  }
+
+  // Marks the future failed with e; see future<T>::set_exception.
+  void* set_exception(std::exception_ptr e) {
+    m_exception.set(std::move(e));
+    return mark_ready();
+  }
+
+  // See future<T>::__store.
+  void __store_exception(std::exception_ptr e) {
+    m_exception.set(std::move(e));
+  }
+
+  void* __attribute__((always_inline)) __complete() {
+    return mark_ready();
+  }
+};
+
+// A future that is touched (get()) exactly once, as in the structured
+// futures benchmarks. Instead of a counted list of waiters it has one
+// slot, so put() is a single exchange, a blocked get() a single CAS,
+// and nothing needs to be set up for waiters that never come. The
+// interface is that of future<T>. Debug builds (no NDEBUG) assert if
+// the future is touched a second time; otherwise that is undefined.
+template<typename T>
+class single_future : public __single_future_base {
+private:
+  typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+
+  T& __attribute__((always_inline)) value() {
+    return *reinterpret_cast<T*>(&m_storage);
+  }
+
+  void __attribute__((always_inline)) destroy_value() {
+    if (!std::is_trivially_destructible<T>::value && ready()
+        && !m_exception.failed())
+      value().~T();
+  }
+
+public:
+  ~single_future() {
+    destroy_value();
+  }
+
+  inline void reset() {
+    destroy_value();
+    reset_base();
+  }
+
+  template<typename... Args>
+  void* __attribute__((always_inline)) emplace(Args&&... args) {
+    new (&m_storage) T(std::forward<Args>(args)...);
+    return mark_ready();
+  }
+
+  // See future<T>::__store.
+  template<typename... Args>
+  void __attribute__((always_inline)) __store(Args&&... args) {
+    new (&m_storage) T(std::forward<Args>(args)...);
+  }
+
+  void* __attribute__((always_inline)) put(const T &result) {
+    return emplace(result);
+  }
+
+  void* __attribute__((always_inline)) put(T &&result) {
+    return emplace(std::move(result));
+  }
+
+  T& __attribute__((always_inline)) get() {
+    wait();
+    return value();
+  }
+
+  // A try_get() that returns non-NULL is the one touch.
+  T* try_get() {
+    if (!this->ready()) return NULL;
+    return &get();
+  }
+
+  T& get_or_spin(int spins = -1) {
+    spin(spins);
+    return get();
+  }
+}; // class single_future
+
+template<>
+class single_future<void> : public __single_future_base {
+public:
+  inline void reset() {
+    reset_base();
+  }
+
+  void* __attribute__((always_inline)) put(void) {
+    return mark_ready();
+  }
+
+  void __attribute__((always_inline)) __store() {}
+
+  void __attribute__((always_inline)) get() {
+    wait();
+  }
+
+  bool try_get() {
+    if (!this->ready()) return false;
+    get();
+    return true;
+  }
+
+  void get_or_spin(int spins = -1) {
+    spin(spins);
+    get();
+  }
+}; // class single_future<void>
+
+static const size_t __future_line_size = 64;
+static const size_t __future_page_size = 4096;
+
+// A future alone on its own cache line(s). Neighbouring futures in a
+// grid are usually put and touched by different workers, and packed
+// together their counters and tails share lines that then bounce
+// between them. A padded_future<T>* converts to a future<T>* as usual.
+template<typename T>
+struct alignas(__future_line_size) padded_future : public future<T> {};
+
+// An array of padded futures, e.g. one per tile of a wavefront.
+//
+// The slots are constructed a page at a time in a cilk_for, so each
+// page is first touched, and on a NUMA machine placed, by one of the
+// workers rather than all by the thread that made the array. reset()
+// gets every slot ready for another run in the same way, which beats
+// freeing and allocating the array again.
+template<typename T>
+class future_array {
+public:
+  typedef padded_future<T> slot_type;
+
+  explicit future_array(size_t n) : m_slots(NULL), m_size(n) {
+    void *p = NULL;
+    if (n > 0 && posix_memalign(&p, __future_page_size, n * sizeof(slot_type)))
+      throw std::bad_alloc();
+    m_slots = static_cast<slot_type*>(p);
+    for_each_page(construct_pages);
+  }
+
+  ~future_array() {
+    for (size_t i = 0; i < m_size; i++)
+      m_slots[i].~slot_type();
+    free(m_slots);
+  }
+
+  future_array(const future_array&) = delete;
+  future_array& operator=(const future_array&) = delete;
+
+  void reset() {
+    for_each_page(reset_pages);
+  }
+
+  slot_type& operator[](size_t i) { return m_slots[i]; }
+  slot_type* data() { return m_slots; }
+  size_t size() const { return m_size; }
+
+private:
+  slot_type *m_slots;
+  size_t m_size;
+
+  static const size_t per_page = (sizeof(slot_type) < __future_page_size)
+    ? __future_page_size / sizeof(slot_type) : 1;
+
+  void for_each_page(__cilk_abi_f64_t body) {
+    __cilkrts_cilk_for_64(body, this, (m_size + per_page - 1) / per_page, 0);
+  }
+
+  static void construct_pages(void *data, cilk64_t low, cilk64_t high) {
+    future_array *a = static_cast<future_array*>(data);
+    size_t end = (high * per_page < a->m_size) ? high * per_page : a->m_size;
+    for (size_t i = low * per_page; i < end; i++)
+      new (&a->m_slots[i]) slot_type();
+  }
+
+  static void reset_pages(void *data, cilk64_t low, cilk64_t high) {
+    future_array *a = static_cast<future_array*>(data);
+    size_t end = (high * per_page < a->m_size) ? high * per_page : a->m_size;
+    for (size_t i = low * per_page; i < end; i++)
+      a->m_slots[i].reset();
+  }
+}; // class future_array
+
+// Futures of one type, in an array.
+template<typename Fut>
+struct __future_range {
+  Fut *futs;
+
+  bool ready(size_t i) const { return futs[i].ready(); }
+  bool add_waiter(size_t i, __cilkrts_deque_link *link) const {
+    return futs[i].__add_waiter(link);
+  }
+};
+
+template<typename Fut>
+bool __ready_thunk(void *fut) {
+  return static_cast<Fut*>(fut)->ready();
+}
+
+template<typename Fut>
+bool __add_waiter_thunk(void *fut, __cilkrts_deque_link *link) {
+  return static_cast<Fut*>(fut)->__add_waiter(link);
+}
+
+// Futures of any types, as passed to the variadic forms.
+struct __future_list {
+  void *const *futs;
+  bool (*const *readies)(void*);
+  bool (*const *add_waiters)(void*, __cilkrts_deque_link*);
+
+  bool ready(size_t i) const { return readies[i](futs[i]); }
+  bool add_waiter(size_t i, __cilkrts_deque_link *link) const {
+    return add_waiters[i](futs[i], link);
+  }
+};
+
+// Suspends until need of the n futures in set are ready. However many
+// it waits for, the deque is suspended and resumed at most once.
+template<typename Set>
+void __wait_for(const Set &set, size_t n, int need) {
+  __cilkrts_join *j = __cilkrts_join_create(n, need);
+  int registered = 0, ready = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (set.add_waiter(i, &j->links[i])) registered++;
+    else ready++;
+  }
+  __cilkrts_join_wait(j, registered, ready);
+}
+
+template<typename Set>
+void __when_all(const Set &set, size_t n) {
+  size_t i = 0;
+  while (i < n && set.ready(i)) i++;
+  if (i < n) __wait_for(set, n, n);
+}
+
+template<typename Set>
+size_t __when_any(const Set &set, size_t n) {
+  assert(n > 0);
+  for (size_t i = 0; i < n; i++)
+    if (set.ready(i)) return i;
+  __wait_for(set, n, 1);
+  for (size_t i = 0; i < n; i++)
+    if (set.ready(i)) return i;
+  assert(!"when_any woke with no future ready");
+  return n;
+}
+
+// Returns once all of futs[0..n) are ready; get() on them then never
+// blocks. Instead of suspending on each future that is not ready in
+// turn, it suspends once and is resumed by the last of them to be put.
+// Only cilk::future (and padded_future) can be waited on this way.
+template<typename Fut>
+inline void when_all(Fut *futs, size_t n) {
+  __future_range<Fut> set = { futs };
+  __when_all(set, n);
+}
+
+// Returns the index of one of futs[0..n) that is ready, suspending at
+// most once until one is. The other futures keep a small record of the
+// wait until they are put, reset or destroyed.
+template<typename Fut>
+inline size_t when_any(Fut *futs, size_t n) {
+  __future_range<Fut> set = { futs };
+  return __when_any(set, n);
+}
+
+// when_all(f1, f2, ...) and when_any(f1, f2, ...) on futures of any
+// types. when_any returns the position of a ready one in the list.
+template<typename Fut, typename... Futs>
+inline auto when_all(Fut &fut, Futs&... futs)
+  -> decltype(fut.__add_waiter(NULL), void()) {
+  void *const f[] = { &fut, &futs... };
+  bool (*const r[])(void*) = { __ready_thunk<Fut>, __ready_thunk<Futs>... };
+  bool (*const a[])(void*, __cilkrts_deque_link*) =
+    { __add_waiter_thunk<Fut>, __add_waiter_thunk<Futs>... };
+  __future_list set = { f, r, a };
+  __when_all(set, 1 + sizeof...(Futs));
+}
+
+template<typename Fut, typename... Futs>
+inline auto when_any(Fut &fut, Futs&... futs)
+  -> decltype(fut.__add_waiter(NULL), size_t()) {
+  void *const f[] = { &fut, &futs... };
+  bool (*const r[])(void*) = { __ready_thunk<Fut>, __ready_thunk<Futs>... };
+  bool (*const a[])(void*, __cilkrts_deque_link*) =
+    { __add_waiter_thunk<Fut>, __add_waiter_thunk<Futs>... };
+  __future_list set = { f, r, a };
+  return __when_any(set, 1 + sizeof...(Futs));
+}
+
+// Lets whoever started a group of futures (say, the futures working on
+// one request) give up on them, e.g. after a timeout. Cancellation is
+// cooperative: a body keeps running until it returns or polls the
+// token and throws future_cancelled, but anyone blocked in get() on one
+// of the group's futures is resumed right away and gets
+// future_cancelled instead of the result. A body that throws finishes
+// its future early, so whatever is left of the subgraph unwinds as the
+// bodies poll.
+//
+// Since the bodies may still be running, a cancelled future must not
+// be deleted or reset until they are done (e.g. after a when_all on the
+// group, or once the bodies are known to have returned). The token must
+// outlive its futures.
+class cancel_token {
+private:
+  // Each get() waiting on one of the token's futures waits on the
+  // future and on the token at once, through a join with two links.
+  // The token's links are kept here, chained through their next
+  // fields, until cancel() takes them all or their waiter, woken by
+  // its future, takes its own back. A simple spin lock guards the
+  // list; it is only taken when a get() has to wait.
+  __cilkrts_deque_link *volatile m_waiters;
+  volatile int m_lock;
+  volatile int m_requested;
+
+  cancel_token(const cancel_token&) = delete;
+  cancel_token& operator=(const cancel_token&) = delete;
+
+  void lock() {
+    while (__atomic_exchange_n(&m_lock, 1, __ATOMIC_ACQUIRE))
+      while (m_lock);
+  }
+
+  void unlock() {
+    __atomic_store_n(&m_lock, 0, __ATOMIC_RELEASE);
+  }
+
+  void signal() {
+    lock();
+    int already = __atomic_exchange_n(&m_requested, 1, __ATOMIC_SEQ_CST);
+    __cilkrts_deque_link *link = m_waiters;
+    m_waiters = NULL;
+    unlock();
+    if (already) return;
+
+    // Each arrival may resume a waiter and free its join, so read the
+    // next link first.
+    while (link) {
+      __cilkrts_deque_link *next = link->next;
+      __cilkrts_make_resumable_links(link, 1);
+      link = next;
+    }
+  }
+
+public:
+  cancel_token() : m_waiters(NULL), m_lock(0), m_requested(0) {}
+
+  ~cancel_token() {
+    // Nothing should be waiting any more.
+    signal();
+  }
+
+  // Cancels every future tied to the token. Later calls do nothing.
+  void cancel() {
+    signal();
+  }
+
+  // One load, so bodies can afford to poll it in their inner loops.
+  bool __attribute__((always_inline)) cancelled() {
+    return __builtin_expect(__atomic_load_n(&m_requested, __ATOMIC_ACQUIRE), 0);
+  }
+
+  void __attribute__((always_inline)) throw_if_cancelled() {
+    if (cancelled()) throw future_cancelled();
+  }
+
+  // Puts link in the list unless the token is cancelled, in which case
+  // it returns false; see future<T>::__add_waiter.
+  bool __add_waiter(__cilkrts_deque_link *link) {
+    lock();
+    bool added = !m_requested;
+    if (added) {
+      link->next = m_waiters;
+      m_waiters = link;
+    }
+    unlock();
+    return added;
+  }
+
+  // Takes link back out of the list, for a waiter that its future woke
+  // up. Returns false if cancel() already took it, in which case
+  // cancel() counts it in instead.
+  bool __remove_waiter(__cilkrts_deque_link *link) {
+    lock();
+    bool found = false;
+    if (!m_requested) {
+      __cilkrts_deque_link *volatile *p = &m_waiters;
+      while (*p != link) p = &(*p)->next;
+      *p = link->next;
+      found = true;
+    }
+    unlock();
+    return found;
+  }
+};
+
+// get() on a future with a token: waits for either, suspending at most
+// once. The join's link on the token is taken back before returning,
+// so a token that outlives many waits holds none of them.
+template<typename Fut>
+void __attribute__((noinline))
+__wait_cancellable(Fut *fut, cancel_token *token) {
+  if (!token->cancelled()) {
+    __cilkrts_join *j = __cilkrts_join_create(2, 1);
+    __cilkrts_deque_link *token_link = &j->links[1];
+    int registered = 0, ready = 0;
+    if (fut->__add_waiter(&j->links[0])) registered++;
+    else ready++;
+    bool on_token = token->__add_waiter(token_link);
+    if (on_token) registered++;
+    else ready++;
+    __cilkrts_join_wait(j, registered, ready);
+
+    // The join is done, so this only drops the link's hold on it.
+    if (on_token && token->__remove_waiter(token_link))
+      __cilkrts_make_resumable_links(token_link, 1);
+  }
+  if (!fut->ready())
+    throw future_cancelled();
+}
+
+template<std::size_t... I> struct __index_seq {};
+
+template<std::size_t N, std::size_t... I>
+struct __make_index_seq : __make_index_seq<N-1, N-1, I...> {};
+
+template<std::size_t... I>
+struct __make_index_seq<0, I...> { typedef __index_seq<I...> type; };
+
+// Runs the body and stores its result in fut, without marking fut
+// ready yet.
+template<typename T, typename F, typename Tuple, std::size_t... I>
+inline void __attribute__((always_inline))
+__run_and_store(future<T> *fut, F &func, Tuple &args, __index_seq<I...>) {
+  fut->__store(func(std::get<I>(args)...));
+}
+
+template<typename F, typename Tuple, std::size_t... I>
+inline void __attribute__((always_inline))
+__run_and_store(future<void> *fut, F &func, Tuple &args, __index_seq<I...>) {
+  func(std::get<I>(args)...);
+}
+
+template<typename T, typename F, typename Tuple, std::size_t... I>
+inline void __attribute__((always_inline))
+__run_and_store(single_future<T> *fut, F &func, Tuple &args, __index_seq<I...>) {
+  fut->__store(func(std::get<I>(args)...));
+}
+
+template<typename F, typename Tuple, std::size_t... I>
+inline void __attribute__((always_inline))
+__run_and_store(single_future<void> *fut, F &func, Tuple &args, __index_seq<I...>) {
+  func(std::get<I>(args)...);
+}
+
+// Runs on the future's fiber. The callable and its arguments are
+// copied into this frame before we detach: after that the parent may
+// be stolen and whatever they referred to on its stack can go away.
+//
+// An exception from the body must not get past this frame, which has
+// no parent to unwind into; it goes into the future instead, and the
+// waiters are resumed to rethrow it. The handler is only in the unwind
+// tables, so a body that does not throw costs nothing more. It covers
+// only the body: the future is marked ready after it, exactly once.
+template<typename Fut, typename F, typename... Args>
+void __attribute__((noinline))
+__spawn_future_helper(Fut *fut, F &&func, Args&&... args) {
+  typename std::decay<F>::type f(std::forward<F>(func));
+  std::tuple<typename std::decay<Args>::type...> a(std::forward<Args>(args)...);
+
+  FUTURE_HELPER_PREAMBLE;
+  fut->__set_producer(sf.worker);
+
+  try {
+    __run_and_store(fut, f, a,
+        typename __make_index_seq<sizeof...(Args)>::type());
+  } catch (...) {
+    fut->__store_exception(std::current_exception());
+  }
+  void *__cilk_deque = fut->__complete();
+  if (__builtin_expect(__cilk_deque != NULL, 0)) {
+    __cilkrts_resume_suspended(__cilk_deque, 2);
+  }
+
+  FUTURE_HELPER_EPILOGUE;
+}
+
+template<typename Fut, typename F, typename... Args>
+void __attribute__((noinline))
+__spawn_future(Fut *fut, F &&func, Args&&... args) {
+  __cilkrts_stack_frame sf;
+  __cilkrts_enter_frame_1(&sf);
+
+  START_FIRST_FUTURE_SPAWN;
+    __spawn_future_helper(fut, std::forward<F>(func), std::forward<Args>(args)...);
+  END_FUTURE_SPAWN;
+
+  __cilkrts_pop_frame(&sf);
+  __cilkrts_leave_frame(&sf);
+}
+
+// Runs func(args...) as a future and puts its result into fut. Unlike
+// the old std::bind/std::function path nothing is type-erased or
+// allocated: the call is instantiated for F and Args, and the closure
+// lives on the future's fiber.
+template<typename T, typename F, typename... Args>
+inline void __attribute__((always_inline))
+spawn_future(future<T> *fut, F &&func, Args&&... args) {
+  __spawn_future(fut, std::forward<F>(func), std::forward<Args>(args)...);
+}
+
+template<typename T, typename F, typename... Args>
+inline void __attribute__((always_inline))
+spawn_future(single_future<T> *fut, F &&func, Args&&... args) {
+  __spawn_future(fut, std::forward<F>(func), std::forward<Args>(args)...);
+}
+
+// As above, but ties fut to token (see cancel_token). If the token is
+// already cancelled, func is not run at all and fut fails with
+// future_cancelled right away.
+template<typename T, typename F, typename... Args>
+inline void spawn_future(future<T> *fut, cancel_token &token,
+                         F &&func, Args&&... args) {
+  fut->__set_token(&token);
+  if (token.cancelled()) {
+    void *d = fut->set_exception(std::make_exception_ptr(future_cancelled()));
+    if (d) __cilkrts_make_resumable(d);
+    return;
+  }
+  __spawn_future(fut, std::forward<F>(func), std::forward<Args>(args)...);
+}
+
+// The body of a continuation: calls func on the result of prev, which
+// is ready by the time it runs.
+template<typename T, typename F>
+struct __then_body {
+  F func;
+  __then_result_t<T, F> operator()(future<T> *prev) { return func(prev->get()); }
+};
+
+template<typename F>
+struct __then_body<void, F> {
+  F func;
+  __then_result_t<void, F> operator()(future<void> *prev) { return func(); }
+};
+
+template<typename T, typename F>
+struct __then_cont : __future_cont {
+  future<T> *prev;
+  future<__then_result_t<T, F>> *fut;
+  __then_body<T, F> body;
+
+  template<typename G>
+  __then_cont(future<T> *prev, G &&func)
+    : prev(prev), fut(new future<__then_result_t<T, F>>()),
+      body{std::forward<G>(func)} {
+    this->run = start;
+  }
+
+  // spawn_future copies the body onto the new future's fiber before
+  // anything can run in parallel with us, so we can go right away.
+  static void start(__future_cont *c) {
+    __then_cont *self = static_cast<__then_cont*>(c);
+    spawn_future(self->fut, std::move(self->body), self->prev);
+    delete self;
+  }
+};
+
+template<typename T, typename F>
+future<__then_result_t<T, F>>* __then(future<T> *prev, F &&func) {
+  typedef typename std::decay<F>::type Fn;
+  __then_cont<T, Fn> *c = new __then_cont<T, Fn>(prev, std::forward<F>(func));
+
+  // c may be gone as soon as it is attached.
+  future<__then_result_t<T, Fn>> *fut = c->fut;
+  prev->__attach(c);
+  return fut;
+}
+
+// Body of a lazy future (see cilk_future_create__lazy). It runs as a
+// plain spawned child, so we cannot switch to a waiter's deque here
+// the way __spawn_future_helper does; the first waiter is just made
+// resumable like the rest. Arguments are taken by value, since the
+// parent's continuation may go on and change them.
+template<typename T, typename F, typename... Args>
+void __lazy_future_body(future<T> *fut, F func, Args... args) {
+  try {
+    fut->__store(func(args...));
+  } catch (...) {
+    fut->__store_exception(std::current_exception());
+  }
+  void *__cilk_deque = fut->__complete();
+  if (__builtin_expect(__cilk_deque != NULL, 0)) {
+    __cilkrts_make_resumable(__cilk_deque);
+  }
+}
+
+template<typename F, typename... Args>
+void __lazy_future_body(future<void> *fut, F func, Args... args) {
+  try {
+    func(args...);
+  } catch (...) {
+    fut->__store_exception(std::current_exception());
+  }
+  void *__cilk_deque = fut->__complete();
+  if (__builtin_expect(__cilk_deque != NULL, 0)) {
+    __cilkrts_make_resumable(__cilk_deque);
+  }
+}
+
+template<typename F, typename... Args>
+using __async_result_t = typename std::result_of<
+  typename std::decay<F>::type&(typename std::decay<Args>::type&...)>::type;
+
+// Like std::async: allocates a future for the result of func(args...)
+// and spawns it. The caller owns (and deletes) the returned future.
+template<typename F, typename... Args>
+future<__async_result_t<F, Args...>>* async(F &&func, Args&&... args) {
+  future<__async_result_t<F, Args...>> *fut =
+    new future<__async_result_t<F, Args...>>();
+  spawn_future(fut, std::forward<F>(func), std::forward<Args>(args)...);
+  return fut;
+}
+
+template<typename Fut, typename Body>
+void __future_for(Fut *futs, size_t lo, size_t hi, Body &body);
+
+template<typename Fut, typename Body>
+void __attribute__((noinline))
+__future_for_helper(Fut *futs, size_t lo, size_t hi, Body &body) {
+  SPAWN_HELPER_PREAMBLE;
+  __future_for(futs, lo, hi, body);
+  SPAWN_HELPER_EPILOGUE;
+}
+
+// Spawns the lower half and keeps the upper half, so that on the
+// worker that started it the futures are still created in index order.
+template<typename Fut, typename Body>
+void __attribute__((noinline))
+__future_for(Fut *futs, size_t lo, size_t hi, Body &body) {
+  CILK_FUNC_PREAMBLE;
+
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (!CILK_SETJMP(sf.ctx)) {
+      __future_for_helper(futs, lo, mid, body);
+    }
+    lo = mid;
+  }
+  spawn_future(&futs[lo], body, lo);
+
+  CILK_FUNC_EPILOGUE;
+}
+
+// Runs body(i) as the future futs[i] for each i in [lo, hi). The
+// futures are created by a divide-and-conquer spawn tree rather than a
+// loop, so thieves share the work of creating them and the span of
+// creation is logarithmic in hi - lo. Returns once every future has
+// been created (not finished); each is then touched with get() as
+// usual. Bodies may get() other futures in the range, including ones
+// not yet created, as in a wavefront. body is copied into each future.
+template<typename Fut, typename Body>
+inline void future_for(Fut *futs, size_t lo, size_t hi, Body body) {
+  if (lo < hi) __future_for(futs, lo, hi, body);
+}
+
+template<typename T, typename Body>
+inline void future_for(future_array<T> &futs, Body body) {
+  future_for(futs.data(), 0, futs.size(), body);
+}
+
 } // namespace cilk
 
 #endif // #ifndef __CILK__FUTURE_H__
@@ -434,6 +434,27 @@ typedef struct __cilkrts_deque_link {
   struct __cilkrts_deque_link *volatile next;
 } __cilkrts_deque_link;
 
+/**
+ * One strand waiting on several futures at once (cilk::when_all and
+ * cilk::when_any).  It goes into each future's waiter list through its
+ * own entry in links[], whose d is the join or'd with
+ * __CILKRTS_JOIN_TAG rather than a deque.  The deque is resumed once,
+ * by the put that brings the number of futures put to need.
+ */
+typedef struct __cilkrts_join {
+  void *deque;
+  int n;                         /* entries in links[] */
+  int need;                      /* puts to wait for */
+  volatile int state;            /* futures put, plus __CILKRTS_JOIN_HOLD
+                                    until the waiter is registered */
+  volatile int refs;             /* links[] still in some list, plus one
+                                    for the waiter */
+  __cilkrts_deque_link links[1]; /* really n of them */
+} __cilkrts_join;
+
+#define __CILKRTS_JOIN_TAG  1
+#define __CILKRTS_JOIN_HOLD (1 << 30)
+
 /**
  * Call __cilkrts_enter_frame to initialize an ABI 0 frame descriptor.
  * Initialize the frame descriptor before spawn or detach.  A function that
@@ -489,8 +510,93 @@ CILK_ABI(void) __cilkrts_suspend(void);
 
 CILK_ABI(void*) __cilkrts_get_deque(void);
 CILK_ABI(void) __cilkrts_suspend_deque(void);
+
+/**
+ * Like __cilkrts_suspend_deque, for a get() on a future whose body
+ * started on worker producer (may be NULL).  If the worker goes back
+ * to stealing and CILK_HELP_PRODUCER is set, its first attempt is on
+ * producer.
+ */
+CILK_ABI(void) __cilkrts_suspend_deque_on(__cilkrts_worker *producer);
+
+/**
+ * Like __cilkrts_suspend_deque_on, for a future with a priority hint.
+ * Once the future is put, a deque suspended with a priority above 0
+ * is resumed ahead of the others waiting on the same worker (within
+ * the limit set by CILK_PRIORITY_BURST).
+ */
+CILK_ABI(void) __cilkrts_suspend_deque_at(__cilkrts_worker *producer,
+                                          int priority);
+
+/**
+ * Called by get() before it suspends on a future that is not ready.
+ * Returns 1 if the caller should suspend, having reserved it a place
+ * under the cap on suspended deques (CILK_MAX_SUSPENDED).  If the cap
+ * has been reached, waits in place instead and returns 0 once *state,
+ * the future's waiter count, has gone negative.
+ */
+CILK_ABI(int) __cilkrts_may_suspend(volatile int *state);
+
+/**
+ * The same, for a future whose state is a single pointer-sized slot:
+ * any wait is until *slot == ready.
+ */
+CILK_ABI(int) __cilkrts_may_suspend_until(void *volatile *slot, void *ready);
+
+/**
+ * Called by get_or_spin() on a future that is not ready: spins for up
+ * to spins pauses (CILK_GET_SPINS if negative) waiting for *state to
+ * go negative.  Returns 1 if it did, 0 if the caller should go on and
+ * suspend.
+ */
+CILK_ABI(int) __cilkrts_spin_until_ready(volatile int *state, int spins);
+
+/**
+ * The same, waiting for *slot == ready.
+ */
+CILK_ABI(int) __cilkrts_spin_until_ready_slot(void *volatile *slot, void *ready,
+                                              int spins);
 CILK_ABI(void) __cilkrts_resume_suspended(void*, int);
 CILK_ABI(void) __cilkrts_make_resumable(void*);
+CILK_ABI(void) __cilkrts_make_resumable_chain(void*, int);
+
+/**
+ * Makes the n waiters starting at link resumable, as
+ * __cilkrts_make_resumable_chain does for a list of deques, counting in
+ * any joins among them.
+ */
+CILK_ABI(void) __cilkrts_make_resumable_links(__cilkrts_deque_link *link, int n);
+
+/**
+ * The same, but returns the first deque to wake for the caller to
+ * resume itself, as put() does.  Returns NULL if the waiters were all
+ * joins and none of them is done waiting.
+ */
+CILK_ABI(void*) __cilkrts_take_waiter_links(__cilkrts_deque_link *link, int n);
+
+/**
+ * Returns a join for the current deque with n links, to wait for need
+ * of n futures.  The caller puts links[i] in the i-th future's list if
+ * that future is not ready, then calls __cilkrts_join_wait.
+ */
+CILK_ABI(__cilkrts_join*) __cilkrts_join_create(int n, int need);
+
+/**
+ * Suspends the current deque until j is done, unless it already is,
+ * and frees j once no list refers to it.  registered is the number of
+ * links that went into a list and ready the number of futures that
+ * were already put instead.  Like get(), it waits in place rather than
+ * suspend past CILK_MAX_SUSPENDED.
+ */
+CILK_ABI(void) __cilkrts_join_wait(__cilkrts_join *j, int registered, int ready);
+
+/**
+ * Gives back the n links starting at link, the waiters of a future
+ * that is being reset or destroyed without having been put.  Each must
+ * belong to a join that is already done (a when_any that another
+ * future satisfied); the join is freed once nothing else refers to it.
+ */
+CILK_ABI(void) __cilkrts_drop_waiter_links(__cilkrts_deque_link *link, int n);
 
 /**
  * Resumes the runtime by notifying the workers that they can steal.
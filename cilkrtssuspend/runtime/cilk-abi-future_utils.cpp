@@ -23,11 +23,7 @@ CILK_ABI_VOID __attribute__((always_inline)) __cilkrts_switch_fibers_back(cilk_f
     __cilkrts_worker *curr_worker = __cilkrts_get_tls_worker_fast();
     cilk_fiber *curr_fiber = cilk_fiber_get_current_fiber();
 
-    int dealloc = 1;
-    if (curr_worker->l->future_fiber_pool_idx < (MAX_FUTURE_FIBERS_IN_POOL-1)) {
-        curr_worker->l->future_fiber_pool[++curr_worker->l->future_fiber_pool_idx] = curr_fiber;
-        dealloc = 0;
-    }
+    int dealloc = !future_fiber_cache_put(curr_worker, &curr_worker->l->future_fibers, curr_fiber);
 
 #ifdef TRACK_FIBER_COUNT
     decrement_fiber_count(curr_worker->g);
@@ -45,13 +41,7 @@ CILK_ABI(char*) __attribute__((always_inline)) __cilkrts_switch_fibers() {
     __cilkrts_worker* curr_worker = __cilkrts_get_tls_worker_fast();
 
     // This is a little faster than normal fiber allocate when used for future fibers.
-    cilk_fiber* new_exec_fiber = NULL;
-    if (curr_worker->l->future_fiber_pool_idx >= 0) {
-        new_exec_fiber = curr_worker->l->future_fiber_pool[curr_worker->l->future_fiber_pool_idx--];
-    } else {
-        //new_exec_fiber = cilk_fiber_allocate_with_try_allocate_from_pool(&(curr_worker->l->fiber_pool));
-        new_exec_fiber = cilk_fiber_allocate(&(curr_worker->l->fiber_pool));
-    }
+    cilk_fiber* new_exec_fiber = future_fiber_cache_get(curr_worker, &curr_worker->l->future_fibers);
     CILK_ASSERT(new_exec_fiber != NULL);
 
 #ifdef TRACK_FIBER_COUNT
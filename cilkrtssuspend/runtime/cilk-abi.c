@@ -76,6 +76,7 @@
 #include "except.h"
 #include "cilk_malloc.h"
 #include "record-replay.h"
+#include "parking.h"
 
 #include <errno.h>
 #include <string.h>
@@ -187,6 +188,11 @@ CILK_ABI_VOID __cilkrts_detach(struct __cilkrts_stack_frame *self)
 	 *  or the second store is a release (st8.rel on Itanium) */
 	*w->tail = tail;
 	self->flags |= CILK_FRAME_DETACHED;
+
+	// There is something to steal now. This is only a hint: no fence,
+	// so we may miss a worker that is just parking, but the park
+	// timeout covers that (and inlined spawns, which never get here).
+	parking_wake(w->g, 1);
 }
 
 /**
@@ -489,6 +495,7 @@ CILK_ABI_WORKER_PTR BIND_THREAD_RTN(void)
 
 	__cilkrts_set_tls_worker(w);
 	__cilkrts_cilkscreen_establish_worker(w);
+	set_current_worker_affinity_sysdep(w);
 
 	START_INTERVAL(w, INTERVAL_IN_SCHEDULER);
 	START_INTERVAL(w, INTERVAL_IN_RUNTIME);
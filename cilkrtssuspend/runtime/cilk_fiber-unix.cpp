@@ -56,6 +56,7 @@
 #include "global_state.h" 
 extern global_state_t *__cilkrts_global_state;
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 
@@ -362,4 +363,61 @@ void cilk_fiber_sysdep::free_stack()
 	}
 }
 
+void cilk_fiber_sysdep::recycle_stack()
+{
+	size_t keep = __cilkrts_global_state->stack_recycle_size;
+	if (0 == keep || NULL == m_stack)
+		return;
+
+	// Never pull pages out from under ourselves
+	char *sp = (char*)__builtin_frame_address(0);
+	if (sp >= m_stack && sp < m_stack_base + s_page_size)
+		return;
+
+	// Everything in [low, limit) may be given back; the top of the
+	// stack above limit stays warm for the next user of the fiber.
+	char *low = m_stack + s_page_size; // just above the guard page
+	char *limit = (char*)((size_t)(m_stack_base - keep) & ~(s_page_size - 1));
+	if (limit <= low)
+		return;
+
+	// Find the stack's high-water mark, i.e. its deepest resident page.
+	// Stacks grow down, so this is the lowest resident page above low.
+	const size_t chunk = 256;
+	unsigned char resident[chunk];
+	char *high_water = limit;
+	for (char *p = low; p < limit; p += chunk * s_page_size) {
+		size_t len = std::min((size_t)(limit - p), chunk * s_page_size);
+		if (mincore(p, len, resident) < 0)
+			return;
+		size_t npages = len / s_page_size;
+		size_t i = 0;
+		while (i < npages && !(resident[i] & 1))
+			i++;
+		if (i < npages) {
+			high_water = p + i * s_page_size;
+			break;
+		}
+	}
+
+	if (high_water == limit)
+		return; // never grew past what we keep
+
+	// MADV_DONTNEED drops the pages right away, so RSS goes down.
+	// MADV_FREE is cheaper, but the kernel only reclaims the pages under
+	// memory pressure, so they are still counted in RSS until then; it
+	// is opt-in, and older kernels reject it.
+#ifdef MADV_FREE
+	static volatile int use_madv_free = 1;
+	if (__cilkrts_global_state->stack_recycle_lazy && use_madv_free) {
+		if (madvise(high_water, limit - high_water, MADV_FREE) == 0)
+			return;
+		if (errno != EINVAL)
+			return;
+		use_madv_free = 0;
+	}
+#endif
+	madvise(high_water, limit - high_water, MADV_DONTNEED);
+}
+
 /* End cilk_fiber-unix.cpp */
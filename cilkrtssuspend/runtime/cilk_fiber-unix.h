@@ -139,6 +139,17 @@ public:
 
     inline void** get_resume_jmpbuf() { return m_resume_jmpbuf; }
 
+	/**
+	 * @brief Returns the unused part of this fiber's stack to the OS.
+	 *
+	 * Called when the fiber goes back to a pool.  Keeps the top
+	 * g->stack_recycle_size bytes resident and drops every page between
+	 * the stack's high-water mark and that point, with MADV_DONTNEED
+	 * (or MADV_FREE if g->stack_recycle_lazy is set).  Does nothing if
+	 * stack recycling is off.
+	 */
+	void recycle_stack();
+
 private:
 	char*                       m_stack_base;    ///< The base of this fiber's stack.
 	char*                       m_stack;         ///< Stack memory (low address)
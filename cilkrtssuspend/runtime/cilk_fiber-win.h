@@ -134,6 +134,11 @@ class cilk_fiber_sysdep : public cilk_fiber
      */ 
     inline char* get_stack_base_sysdep() { return NULL; }
 
+    /**
+     * @brief  Not implemented on Windows. 
+     */ 
+    inline void recycle_stack() { }
+
 private:
     void*                       m_win_fiber;      // Windows fiber
     bool                        m_is_user_fiber;  // true if fiber existed
@@ -224,6 +224,10 @@ decrement_fiber_count(__cilkrts_get_tls_worker()->g);
     fiber->take();
   }
 
+  void cilk_fiber_recycle_stack(cilk_fiber *fiber) {
+    fiber->recycle_stack();
+  }
+
   void** __attribute__((always_inline)) cilk_fiber_get_resume_jmpbuf(cilk_fiber *fiber)
   {
     return fiber->get_resume_jmpbuf();
@@ -437,6 +441,11 @@ char* cilk_fiber::get_stack_base()
   return this->sysdep()->get_stack_base_sysdep();
 }
 
+void cilk_fiber::recycle_stack()
+{
+  this->sysdep()->recycle_stack();
+}
+
 void** __attribute__((always_inline)) cilk_fiber::get_resume_jmpbuf()
 {
   return this->sysdep()->get_resume_jmpbuf();
@@ -960,6 +969,9 @@ void cilk_fiber::deallocate_self(cilk_fiber_pool* pool)
   CILK_ASSERT(NULL != pool);
   CILK_ASSERT(!this->is_allocated_from_thread());
   this->assert_ref_count_equals(0);
+
+  // Don't let pooled fibers hold on to pages they no longer use
+  this->recycle_stack();
     
   // Cases: 
   //
@@ -468,6 +468,15 @@ char* cilk_fiber_get_stack(cilk_fiber* fiber);
 
 void cilk_fiber_take(cilk_fiber* fiber);
 
+/**
+ * @brief Gives the pages this idle fiber's stack no longer needs back
+ * to the OS, if stack recycling is on.
+ *
+ * Fibers returned to a pool do this already; caches that hold on to
+ * fibers outside a pool can call it for their spares.
+ */
+void cilk_fiber_recycle_stack(cilk_fiber* fiber);
+
 void** cilk_fiber_get_resume_jmpbuf(cilk_fiber* fiber);
 
 /****************************************************************************
@@ -795,6 +804,8 @@ public:
 
     inline char* get_stack();
 
+    void recycle_stack();
+
 	inline void** get_resume_jmpbuf();
     
 	/** @brief Return the data for this fiber. */ 
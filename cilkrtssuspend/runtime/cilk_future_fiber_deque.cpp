@@ -12,19 +12,25 @@ void __cilkrts_reset_future_fiber_deque() {
     d->fiber_tail = d->fiber_head = d->fiber_ltq;
 }
 
+#define BEGIN_WITH_WORKER_LOCK(w) __cilkrts_worker_lock(w); do
+#define END_WITH_WORKER_LOCK(w)   while (__cilkrts_worker_unlock(w), 0)
+
 void __cilkrts_enqueue_future_fiber(cilk_fiber *fiber) {
     __cilkrts_worker *curr_worker = __cilkrts_get_tls_worker_fast();
+    deque *d = curr_worker->l->active_deque;
 
-    cilk_fiber *volatile *tail = curr_worker->l->active_deque->fiber_tail;
-    *tail++ = fiber;
-    CILK_ASSERT(tail < curr_worker->l->active_deque->fiber_ltq_limit);
+    if (__builtin_expect(d->fiber_tail == d->fiber_ltq_limit, 0)) {
+        // Thieves take from the head under our lock.
+        BEGIN_WITH_WORKER_LOCK(curr_worker) {
+            deque_grow_fiber_ltq(curr_worker, d);
+        } END_WITH_WORKER_LOCK(curr_worker);
+    }
 
-    curr_worker->l->active_deque->fiber_tail = tail;
+    cilk_fiber *volatile *tail = d->fiber_tail;
+    *tail++ = fiber;
+    d->fiber_tail = tail;
 }
 
-#define BEGIN_WITH_WORKER_LOCK(w) __cilkrts_worker_lock(w); do
-#define END_WITH_WORKER_LOCK(w)   while (__cilkrts_worker_unlock(w), 0)
-
 cilk_fiber* __cilkrts_pop_tail_future_fiber() {
     __cilkrts_worker *curr_worker = __cilkrts_get_tls_worker_fast();
 
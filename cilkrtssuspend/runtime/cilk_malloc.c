@@ -74,6 +74,17 @@ void *__cilkrts_malloc(size_t size)
 #endif
 }
 
+void *__cilkrts_malloc_aligned(size_t size, size_t alignment)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#elif defined HAS_MEMALIGN
+    return memalign(alignment, size);
+#else
+    return malloc(size);
+#endif
+}
+
 void *__cilkrts_realloc(void *ptr, size_t size)
 {
 #ifdef _WIN32
@@ -77,6 +77,18 @@ __CILKRTS_BEGIN_EXTERN_C
  */
 COMMON_PORTABLE void *__cilkrts_malloc(size_t size);
 
+/**
+ * malloc replacement function to allocate memory aligned on a boundary
+ * of @c alignment bytes, if aligned memory allocations are supported by
+ * the OS.  The block is freed with __cilkrts_free.
+ *
+ * @param size Number of bytes to allocate.
+ * @param alignment Required alignment, a power of two.
+ *
+ * @return pointer to memory block allocated, or NULL if unsuccessful.
+ */
+COMMON_PORTABLE void *__cilkrts_malloc_aligned(size_t size, size_t alignment);
+
 /**
  * realloc replacement function to allocate memory aligned on a cache line
  * boundary if aligned memory allocations are supported by the OS.
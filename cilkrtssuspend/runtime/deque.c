@@ -1,9 +1,11 @@
 #include <string.h> // memset
 #include "deque.h"
+#include "cilk_malloc.h"
 #include "local_state.h"
 #include "full_frame.h"
 #include "os.h"
 #include "scheduler.h"
+#include "parking.h"
 
 // Repeated from scheduler.c:
 //#define DEBUG_LOCKS 1
@@ -80,13 +82,21 @@
  * on the THE protocol.
  */
 
-void __attribute__((always_inline)) __cilkrts_insert_deque_into_list(__cilkrts_deque_link *volatile *tail) {
+static inline void insert_link_into_list(__cilkrts_deque_link *volatile *tail, __cilkrts_deque_link *link) {
   CILK_ASSERT(tail);
   CILK_ASSERT(*tail);
+  link->next = NULL;
+  __cilkrts_deque_link* old_tail = __atomic_exchange_n(tail, link, __ATOMIC_SEQ_CST);
+  old_tail->next = link;
+}
+
+void __cilkrts_insert_link_into_list(__cilkrts_deque_link *volatile *tail, __cilkrts_deque_link *link) {
+  insert_link_into_list(tail, link);
+}
+
+void __attribute__((always_inline)) __cilkrts_insert_deque_into_list(__cilkrts_deque_link *volatile *tail) {
   deque* d = (deque*)__cilkrts_get_deque();
-  d->link.next = NULL;
-  __cilkrts_deque_link* old_tail = __atomic_exchange_n(tail, &(d->link), __ATOMIC_SEQ_CST);
-  old_tail->next = &(d->link);
+  insert_link_into_list(tail, &(d->link));
 }
 
 int can_take_fiber_from(deque *d) {
@@ -340,48 +350,334 @@ void __cilkrts_promote_own_deque(__cilkrts_worker *w)
   CILK_ASSERT((*w->l->frame_ff)->fiber_self == starting_fiber);
 }
 
-int deque_init(deque *d, size_t ltqsize)
+// A worker keeps at most this many unused deques; past that, half of
+// them go to the global freelist.
+#define DEQUE_FREELIST_MAX 32
+#define DEQUE_ALIGN 64
+
+// Each deque carries this many LTQ (and fiber LTQ) slots of its own,
+// enough for most suspended deques. A deque only gets a full-size LTQ
+// while it is running; see deque_switch and shrink_ltqs.
+#define DEQUE_SMALL_LTQ (DEQUE_ALIGN / sizeof(void*))
+
+// A worker keeps at most this many unused full-size LTQs of each kind.
+#define LTQ_CACHE_MAX 4
+
+static size_t deque_round_up(size_t n)
+{
+  return (n + DEQUE_ALIGN - 1) & ~((size_t)DEQUE_ALIGN - 1);
+}
+
+static __cilkrts_stack_frame** inline_ltq(deque *d)
 {
-  memset(d, 0, sizeof(deque));
-  d->link.d = d;
-  d->ltq = (__cilkrts_stack_frame **)
-    __cilkrts_malloc(ltqsize * sizeof(__cilkrts_stack_frame*));
+  return (__cilkrts_stack_frame**) ((char*)d + deque_round_up(sizeof(deque)));
+}
+
+static cilk_fiber** inline_fiber_ltq(deque *d)
+{
+  return (cilk_fiber**) ((char*)inline_ltq(d) + DEQUE_ALIGN);
+}
+
+// Allocates a deque and its two small LTQs as one block, each starting
+// on its own cache line.
+static deque* deque_new(void)
+{
+  return (deque*) __cilkrts_malloc_aligned(deque_round_up(sizeof(deque)) + 2 * DEQUE_ALIGN,
+                                           DEQUE_ALIGN);
+}
 
+// Unused full-size LTQs are kept in a list linked through their first
+// slot.
+static void* ltq_get(__cilkrts_worker *w, void **cache, int *cache_size,
+                     size_t bytes)
+{
+  void *ltq = *cache;
+  if (ltq) {
+    *cache = *(void**)ltq;
+    (*cache_size)--;
+    return ltq;
+  }
 
-  if (!d->ltq)
-    return -1;
-  //__cilkrts_bug("Cilk: out of memory for new deques!\n");
+  ltq = __cilkrts_malloc_aligned(bytes, DEQUE_ALIGN);
+  if (!ltq)
+    __cilkrts_bug("Cilk: out of memory for LTQs!\n");
+#ifdef COLLECT_STEAL_STATS
+  w->l->ks_stats.ltq_allocs++;
+#endif
+  return ltq;
+}
 
-  d->fiber_ltq = (cilk_fiber **)
-    __cilkrts_malloc(ltqsize * sizeof(cilk_fiber*));
+static void ltq_put(void **cache, int *cache_size, void *ltq)
+{
+  if (*cache_size >= LTQ_CACHE_MAX) {
+    __cilkrts_free(ltq);
+    return;
+  }
+  *(void**)ltq = *cache;
+  *cache = ltq;
+  (*cache_size)++;
+}
 
-  if (!d->fiber_ltq) {
-    __cilkrts_free(d->ltq);
-    d->ltq = NULL;
-    return -1;
+static void ltq_cache_free(void **cache, int *cache_size)
+{
+  void *ltq;
+  while ((ltq = *cache)) {
+    *cache = *(void**)ltq;
+    __cilkrts_free(ltq);
   }
-  
-  d->ltq_limit = d->ltq + ltqsize;
+  *cache_size = 0;
+}
+
+// Moves the frame LTQ's contents to the start of new_ltq, which has
+// room for size entries, and gives back the old one if it was a
+// full-size LTQ. The deque must not be visible to thieves, or its
+// worker's lock must be held.
+static void move_ltq(__cilkrts_worker *w, deque *d,
+                     __cilkrts_stack_frame **new_ltq, size_t size)
+{
+  __cilkrts_stack_frame **old_ltq = d->ltq;
+  ptrdiff_t n = d->tail - d->head;
+  CILK_ASSERT(n >= 0 && (size_t) n <= size);
+  CILK_ASSERT(d->protected_tail == d->ltq_limit);
+
+  memcpy(new_ltq, (void*) d->head, n * sizeof(__cilkrts_stack_frame*));
+  if (d->exc != EXC_INFINITY)
+    d->exc = new_ltq + (d->exc - d->head);
+  d->ltq = new_ltq;
+  d->ltq_limit = new_ltq + size;
+  d->head = new_ltq;
+  d->tail = new_ltq + n;
+  d->protected_tail = d->ltq_limit;
+
+  if (old_ltq != inline_ltq(d))
+    ltq_put(&w->l->ltq_cache, &w->l->ltq_cache_size, old_ltq);
+}
+
+// Same for the fiber LTQ, which may also have outgrown g->ltqsize.
+static void move_fiber_ltq(__cilkrts_worker *w, deque *d,
+                           cilk_fiber **new_ltq, size_t size)
+{
+  cilk_fiber **old_ltq = d->fiber_ltq;
+  size_t old_size = d->fiber_ltq_limit - d->fiber_ltq;
+  ptrdiff_t n = d->fiber_tail - d->fiber_head;
+  CILK_ASSERT(n >= 0 && (size_t) n <= size);
+
+  memcpy(new_ltq, (void*) d->fiber_head, n * sizeof(cilk_fiber*));
+  d->fiber_ltq = new_ltq;
+  d->fiber_ltq_limit = new_ltq + size;
+  d->fiber_head = new_ltq;
+  d->fiber_tail = new_ltq + n;
+  d->fiber_protected_tail = d->fiber_ltq_limit;
+
+  if (old_ltq == inline_fiber_ltq(d))
+    return;
+  if (old_size == w->g->ltqsize)
+    ltq_put(&w->l->fiber_ltq_cache, &w->l->fiber_ltq_cache_size, old_ltq);
+  else
+    __cilkrts_free(old_ltq);
+}
+
+// Called with the deque's worker lock held, when the fiber LTQ is
+// full.
+void deque_grow_fiber_ltq(__cilkrts_worker *w, deque *d)
+{
+  size_t size = d->fiber_ltq_limit - d->fiber_ltq;
+  cilk_fiber **new_ltq;
+
+  if (size < w->g->ltqsize) {
+    size = w->g->ltqsize;
+    new_ltq = (cilk_fiber**) ltq_get(w, &w->l->fiber_ltq_cache,
+                                     &w->l->fiber_ltq_cache_size,
+                                     size * sizeof(cilk_fiber*));
+  } else {
+    size *= 2;
+    new_ltq = (cilk_fiber**) __cilkrts_malloc_aligned(size * sizeof(cilk_fiber*),
+                                                      DEQUE_ALIGN);
+    if (!new_ltq)
+      __cilkrts_bug("Cilk: out of memory for LTQs!\n");
+  }
+  move_fiber_ltq(w, d, new_ltq, size);
+}
+
+// Gives a deque that is about to run a full-size LTQ. The compiler
+// pushes onto the LTQ without checking for overflow, so this has to
+// happen before anyone can spawn on it.
+static void grow_ltq(__cilkrts_worker *w, deque *d)
+{
+  if (d->ltq != inline_ltq(d))
+    return;
+
+  __cilkrts_stack_frame **ltq = (__cilkrts_stack_frame**)
+    ltq_get(w, &w->l->ltq_cache, &w->l->ltq_cache_size,
+            w->g->ltqsize * sizeof(__cilkrts_stack_frame*));
+  move_ltq(w, d, ltq, w->g->ltqsize);
+}
+
+// A suspended deque keeps only what is left to steal from it, so if
+// that fits, its full-size LTQs go back to the worker for the next
+// deque that runs. We leave a deque alone if stealing from it was
+// disallowed, since someone may be holding on to its protected_tail.
+static void shrink_ltqs(__cilkrts_worker *w, deque *d)
+{
+  if (d->ltq != inline_ltq(d)) {
+    if (d->tail - d->head <= (ptrdiff_t) DEQUE_SMALL_LTQ
+        && d->protected_tail == d->ltq_limit) {
+      move_ltq(w, d, inline_ltq(d), DEQUE_SMALL_LTQ);
+#ifdef COLLECT_STEAL_STATS
+      w->l->ks_stats.ltq_shrinks++;
+    } else {
+      w->l->ks_stats.ltq_kept_full++;
+#endif
+    }
+  }
+
+  if (d->fiber_ltq != inline_fiber_ltq(d)
+      && d->fiber_tail - d->fiber_head <= (ptrdiff_t) DEQUE_SMALL_LTQ)
+    move_fiber_ltq(w, d, inline_fiber_ltq(d), DEQUE_SMALL_LTQ);
+}
+
+// Gives back any full-size LTQs.
+static void release_ltqs(__cilkrts_worker *w, deque *d)
+{
   d->head = d->tail = d->exc = d->ltq;
   d->protected_tail = d->ltq_limit;
+  d->fiber_head = d->fiber_tail = d->fiber_ltq;
 
-  d->fiber_ltq_limit = d->fiber_ltq + ltqsize;
+  if (d->ltq != inline_ltq(d))
+    move_ltq(w, d, inline_ltq(d), DEQUE_SMALL_LTQ);
+  if (d->fiber_ltq != inline_fiber_ltq(d))
+    move_fiber_ltq(w, d, inline_fiber_ltq(d), DEQUE_SMALL_LTQ);
+}
+
+static void deque_init(deque *d)
+{
+  memset(d, 0, sizeof(deque));
+  d->link.d = d;
+  d->resume_link.d = d;
+  d->socket = -1;
+
+  d->ltq = inline_ltq(d);
+  d->ltq_limit = d->ltq + DEQUE_SMALL_LTQ;
+  d->head = d->tail = d->exc = d->ltq;
+  d->protected_tail = d->ltq_limit;
+
+  d->fiber_ltq = inline_fiber_ltq(d);
+  d->fiber_ltq_limit = d->fiber_ltq + DEQUE_SMALL_LTQ;
   d->fiber_head = d->fiber_tail = d->fiber_ltq;
   d->fiber_protected_tail = d->fiber_ltq_limit;
+}
+
+static void push_free(deque **list, deque *d)
+{
+  d->next_free = *list;
+  *list = d;
+}
+
+static deque* pop_free(deque **list)
+{
+  deque *d = *list;
+  if (d)
+    *list = d->next_free;
+  return d;
+}
 
-  return 0;
+deque* deque_alloc(__cilkrts_worker *w)
+{
+  local_state *l = w->l;
+  global_state_t *g = w->g;
+
+  if (!l->deque_freelist && g->deque_freelist_size > 0) {
+    // Take a batch back from the global freelist
+    __cilkrts_mutex_lock(w, &g->deque_freelist_lock); {
+      while (g->deque_freelist_size > 0
+             && l->deque_freelist_size < DEQUE_FREELIST_MAX / 2) {
+        push_free(&l->deque_freelist, pop_free(&g->deque_freelist));
+        g->deque_freelist_size--;
+        l->deque_freelist_size++;
+      }
+    } __cilkrts_mutex_unlock(w, &g->deque_freelist_lock);
+  }
+
+  deque *d = pop_free(&l->deque_freelist);
+  if (d) {
+    l->deque_freelist_size--;
+  } else {
+    d = deque_new();
+    if (!d)
+      return NULL;
+  }
+
+  deque_init(d);
+  return d;
 }
 
-void deque_destroy(deque *d)
+void deque_destroy(__cilkrts_worker *w, deque *d)
 {
   //CILK_ASSERT(d->worker == NULL);
   CILK_ASSERT(d->head == d->tail);
 
   // if/when we use d->lock or d->steal_lock
   //__cilkrts_mutex_destroy
-  __cilkrts_free(d->ltq);
-  __cilkrts_free(d->fiber_ltq);
-  __cilkrts_free(d);
+  local_state *l = w->l;
+  global_state_t *g = w->g;
+
+  release_ltqs(w, d);
+  push_free(&l->deque_freelist, d);
+  if (++l->deque_freelist_size <= DEQUE_FREELIST_MAX)
+    return;
+
+  // Our list is long: hand half of it to the other workers, unless
+  // they already have plenty, in which case just free it.
+  deque *excess = NULL;
+  __cilkrts_mutex_lock(w, &g->deque_freelist_lock); {
+    while (l->deque_freelist_size > DEQUE_FREELIST_MAX / 2) {
+      d = pop_free(&l->deque_freelist);
+      l->deque_freelist_size--;
+      if (g->deque_freelist_size < DEQUE_FREELIST_MAX * g->P) {
+        push_free(&g->deque_freelist, d);
+        g->deque_freelist_size++;
+      } else {
+        push_free(&excess, d);
+      }
+    }
+  } __cilkrts_mutex_unlock(w, &g->deque_freelist_lock);
+
+  while ((d = pop_free(&excess)))
+    __cilkrts_free(d);
+}
+
+void deque_free(__cilkrts_worker *w, deque *d)
+{
+  if (d) {
+    release_ltqs(w, d);
+    __cilkrts_free(d);
+  }
+}
+
+void deque_worker_cleanup(__cilkrts_worker *w)
+{
+  deque *d;
+  while ((d = pop_free(&w->l->deque_freelist)))
+    __cilkrts_free(d);
+  w->l->deque_freelist_size = 0;
+  ltq_cache_free(&w->l->ltq_cache, &w->l->ltq_cache_size);
+  ltq_cache_free(&w->l->fiber_ltq_cache, &w->l->fiber_ltq_cache_size);
+}
+
+void deque_global_init(global_state_t *g)
+{
+  g->deque_freelist = NULL;
+  g->deque_freelist_size = 0;
+  __cilkrts_mutex_init(&g->deque_freelist_lock);
+}
+
+void deque_global_cleanup(global_state_t *g)
+{
+  deque *d;
+  while ((d = pop_free(&g->deque_freelist)))
+    __cilkrts_free(d);
+  g->deque_freelist_size = 0;
+  __cilkrts_mutex_destroy(0, &g->deque_freelist_lock);
 }
 
 void deque_switch(__cilkrts_worker *w, deque *d)
@@ -415,6 +711,8 @@ void deque_switch(__cilkrts_worker *w, deque *d)
     d->call_stack->worker = w;
   }
   CILK_ASSERT(d->worker == NULL);
+  // Nobody else can see d yet, so it is safe to move its LTQ.
+  grow_ltq(w, d);
   d->worker = w;
   d->self = ACTIVE_DEQUE_INDEX;//&w->l->active_deque;
   
@@ -432,6 +730,27 @@ void deque_switch(__cilkrts_worker *w, deque *d)
   memset(&d->saved_ped, 0, sizeof(__cilkrts_pedigree));
 }
 
+// Whether a deque that was just suspended stays with its worker, per
+// g->suspend_policy. The proactive policy hands it to someone else, so
+// that the worker goes out stealing; the parsimonious one keeps it,
+// and the worker then takes work from its own deques, resuming them
+// as they become ready, until they have none left (see random_steal).
+// The hybrid policy keeps deques with something left on them, as long
+// as that is no more than g->suspend_depth frames.
+static int keep_suspended_deque(__cilkrts_worker *w, deque *d)
+{
+  switch (w->g->suspend_policy) {
+  case SUSPEND_PARSIMONIOUS:
+    return 1;
+  case SUSPEND_HYBRID: {
+    ptrdiff_t depth = d->tail - d->head;
+    return depth > 0 && depth <= w->g->suspend_depth;
+  }
+  default:
+    return 0;
+  }
+}
+
 cilk_fiber* deque_suspend(__cilkrts_worker *w, deque *new_deque)
 {
   deque *d = w->l->active_deque;
@@ -444,34 +763,27 @@ cilk_fiber* deque_suspend(__cilkrts_worker *w, deque *new_deque)
   
   d->saved_ped = w->pedigree;
   d->call_stack = w->current_stack_frame;
+  d->socket = w->l->socket;
 
   int attempt_steal = 0;
 
   if (!new_deque) {
     // Before we allocate a new deque, let's see if we have something to resume
-    __cilkrts_mutex_lock(w, &w->l->lock);
-    int size = w->l->resumable_deques.size;
-    if (size > 0) {
-        #ifdef COLLECT_STEAL_STATS
-            w->l->ks_stats.deques_mugged_on_suspend++;
-        #endif
-      new_deque = w->l->resumable_deques.array[size-1];
-      deque_mug(w, new_deque);
-    }
-    __cilkrts_mutex_unlock(w, &w->l->lock);
+    new_deque = deque_queue_pop(w, &w->l->resumable_deques);
+    #ifdef COLLECT_STEAL_STATS
+    if (new_deque)
+        w->l->ks_stats.deques_mugged_on_suspend++;
+    #endif
     /// @todo{ Check other workers, too? }
   }
 
   if (!new_deque) { // Must allocate new
-    new_deque = __cilkrts_malloc(sizeof(deque));
-    if (new_deque
-        && -1 != deque_init(new_deque, w->g->ltqsize)) {
+    new_deque = deque_alloc(w);
+    if (new_deque) {
       new_deque->team = d->team;
       new_deque->fiber = w->l->scheduling_fiber;
       attempt_steal = 1;
     } else {
-      __cilkrts_free(new_deque);
-      new_deque = NULL;
       __cilkrts_bug("Cilk: out of memory for new deques!\n");
     }
   } else {
@@ -561,6 +873,9 @@ cilk_fiber* deque_suspend(__cilkrts_worker *w, deque *new_deque)
         }
     }
 
+    // Nobody else can see d again until we publish it below.
+    shrink_ltqs(w, d);
+
   } END_WITH_WORKER_LOCK(w);
 
 
@@ -570,7 +885,14 @@ cilk_fiber* deque_suspend(__cilkrts_worker *w, deque *new_deque)
 
     __cilkrts_worker *victim = NULL;
 
-    if (__builtin_expect(w->g->total_workers > 1, 1)) {
+    if (keep_suspended_deque(w, d)) {
+        // Parsimonious: we will work through it ourselves (see
+        // choose_deque), unless a thief gets there first.
+        victim = w;
+        #ifdef COLLECT_STEAL_STATS
+        w->l->ks_stats.suspends_kept_local++;
+        #endif
+    } else if (__builtin_expect(w->g->total_workers > 1, 1)) {
         // Probably slightly better balls and bins result compared to random;
         // based on very light testing. slightly better performance in practice.
         int victim_idx = myrand(w) % (w->g->total_workers);
@@ -589,29 +911,19 @@ cilk_fiber* deque_suspend(__cilkrts_worker *w, deque *new_deque)
         DEQUE_LOG("(w: %i) pushing suspended deque %p on to %i\n",
                   w->self, d, victim->self);
 
-        __cilkrts_mutex_lock(w, &victim->l->lock); {
-          if (d->resumable) {
-            deque_pool_add(victim, &victim->l->resumable_deques, d);
-            /* fprintf(stderr, "(w: %i) pushed resumable deque %p on to %i\n", */
-            /*        w->self, d, victim->self); */
-
-          } else if (d->head != d->tail) { // not resumable, but stealable!
+        if (d->resumable) {
+          // Resumable deques are published without the victim's lock
+          d->self = INVALID_DEQUE_INDEX;
+          deque_queue_push(victim, &victim->l->resumable_deques, d);
+        } else {
+          __cilkrts_mutex_lock(w, &victim->l->lock); {
+            // not resumable, but stealable!
             deque_pool_add(victim, &victim->l->suspended_deques, d);
             /* fprintf(stderr, "(w: %i) pushed suspended (stealable) deque %p on to %i\n", */
             /*              w->self, d, victim->self); */
-
-//          } else { // empty: no need to add, will be resumed later
-
-
-//            d->self = INVALID_DEQUE_INDEX;
-//            d->worker = NULL;
-            //      w->l->mugged++;
-
-            /* fprintf(stderr, "(w: %i) suspended non-stealable deque %p on to %i\n", */
-            /*        w->self, d, victim->self); */
-
-          }
-        } __cilkrts_mutex_unlock(w, &victim->l->lock);
+          } __cilkrts_mutex_unlock(w, &victim->l->lock);
+        }
+        parking_wake(w->g, 1);
   } else {
     d->self = INVALID_DEQUE_INDEX;
     d->worker = NULL;
@@ -629,8 +941,9 @@ void deque_mug(__cilkrts_worker *w, deque *d)
   CILK_ASSERT(d->worker->l->lock.owner == w);
   CILK_ASSERT(d->fiber);
 
-  deque_pool *p = (d->resumable) ?
-    &d->worker->l->resumable_deques : &d->worker->l->suspended_deques;
+  // Resumable deques are taken with deque_queue_pop
+  CILK_ASSERT(!d->resumable);
+  deque_pool *p = &d->worker->l->suspended_deques;
   deque_pool_validate(p, d->worker);
 
   DEQUE_LOG("(w: %i) mugged %p from %i\n",
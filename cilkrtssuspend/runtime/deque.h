@@ -55,6 +55,23 @@ struct deque
   __cilkrts_stack_frame *call_stack;
 
   __cilkrts_deque_link link;
+  __cilkrts_deque_link resume_link; // link in a worker's resumable deque_queue
+
+  // Number of deques that follow this one through link (i.e. in the
+  // same future's waiter list) and still need to be made resumable.
+  // Whoever takes this deque from a resumable queue passes them on,
+  // split in two halves (see hand_off_links), so a put() never walks
+  // the whole list and waking n waiters takes O(log n) hand-offs.
+  int resume_chain;
+
+  // Priority of the future this deque is suspended on (0 if none or
+  // not suspended). Resumable deques with a priority above 0 are taken
+  // first; see deque_queue.
+  int priority;
+
+  // Socket of the worker that last ran on this deque's fiber, so that
+  // it can be resumed where its stack is still in cache. -1 if unknown.
+  int socket;
 
   // As long as we allow suspended deques to change which deque_pool
   // they are in, I don't see how to get away with not having these
@@ -63,6 +80,8 @@ struct deque
   // If we don't allow entire suspended deques to be stolen, then I think we can do without this...
   __cilkrts_worker volatile* worker;
   int self; // index into worker's deque pool
+
+  deque *next_free; // link in a deque freelist while unused
 };
 
 void increment_E(__cilkrts_worker *victim, deque* d);
@@ -78,8 +97,19 @@ void __cilkrts_promote_own_deque(__cilkrts_worker *w);
 int can_take_fiber_from(deque *d);
 int fiber_dekker_protocol(__cilkrts_worker *victim, deque *d);
 
-int deque_init(deque *d, size_t ltqsize);
-void deque_destroy(deque *d);
+// Deques are allocated in one cache-line aligned block together with
+// a small ltq and fiber_ltq, and recycled through a per-worker freelist
+// that spills into (and refills from) a global one. A deque that is
+// running gets a full-size (g->ltqsize) ltq, which it gives back when
+// it is suspended with little left on it or destroyed. The fiber_ltq
+// only grows when it fills up; see deque_grow_fiber_ltq.
+deque* deque_alloc(__cilkrts_worker *w);
+void deque_destroy(__cilkrts_worker *w, deque *d);
+void deque_free(__cilkrts_worker *w, deque *d);
+void deque_grow_fiber_ltq(__cilkrts_worker *w, deque *d);
+void deque_worker_cleanup(__cilkrts_worker *w);
+void deque_global_init(global_state_t *g);
+void deque_global_cleanup(global_state_t *g);
 void deque_switch(__cilkrts_worker *w, deque *d);
 cilk_fiber* deque_suspend(__cilkrts_worker *w, deque *new_deque);
 void deque_mug(__cilkrts_worker *w, deque *d);
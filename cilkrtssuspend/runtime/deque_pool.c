@@ -5,6 +5,9 @@
 #include "full_frame.h"
 #include "worker_mutex.h" // __cilkrts_mutex_lock/unlock
 #include "scheduler.h" // __cilkrts_worker_lock/unlock
+#include "worker_topology.h"
+#include "parking.h"
+#include "os.h" // __cilkrts_short_pause, __cilkrts_yield
 
 #define BEGIN_WITH_WORKER_LOCK(w) __cilkrts_worker_lock(w); do
 #define END_WITH_WORKER_LOCK(w)   while (__cilkrts_worker_unlock(w), 0)
@@ -42,6 +45,22 @@ void deque_pool_free(deque_pool *p)
   __cilkrts_free(p->array);
 }
 
+// Locks and returns the worker whose pool holds d, or returns NULL if
+// d is not in any pool. A thief may move d to its own pool (see
+// deque_pool_steal_batch) before we get the lock, so check again once
+// we have it.
+static __cilkrts_worker* lock_pool_owner(__cilkrts_worker *w, deque *d)
+{
+  __cilkrts_worker *owner;
+  while ((owner = (__cilkrts_worker*) d->worker)) {
+    __cilkrts_mutex_lock(w, &owner->l->lock);
+    if (d->worker == owner)
+      return owner;
+    __cilkrts_mutex_unlock(w, &owner->l->lock);
+  }
+  return NULL;
+}
+
 void* __cilkrts_get_deque(void)
 {
   __cilkrts_worker *w = __cilkrts_get_tls_worker_fast();
@@ -49,9 +68,20 @@ void* __cilkrts_get_deque(void)
 }
 
 void __cilkrts_suspend_deque()
+{
+  __cilkrts_suspend_deque_on(NULL);
+}
+
+void __cilkrts_suspend_deque_on(__cilkrts_worker *producer)
+{
+  __cilkrts_suspend_deque_at(producer, 0);
+}
+
+void __cilkrts_suspend_deque_at(__cilkrts_worker *producer, int priority)
 {
   __cilkrts_worker *w = __cilkrts_get_tls_worker_fast();
   cilk_fiber *current_fiber, *fiber_to_resume;
+  deque *self = w->l->active_deque;
 
   // I think this was just for cleanliness, but somewhere along the
   // line it is not always true. I *think* it's okay to just not check
@@ -59,6 +89,14 @@ void __cilkrts_suspend_deque()
   /* cilk_fiber_data* data = cilk_fiber_get_data((*w->l->frame_ff)->fiber_self); */
   /* CILK_ASSERT(data && data->resume_sf == NULL); */
 
+  global_state_t *g = w->g;
+  int reserved = w->l->suspend_reserved;
+  w->l->suspend_reserved = 0;
+
+  // Nobody can make us resumable before the fiber below is suspended,
+  // so this is in place by the time we are queued.
+  self->priority = priority;
+
   // Sets fiber in active deque
   current_fiber = deque_suspend(w, NULL);
   
@@ -80,8 +118,157 @@ void __cilkrts_suspend_deque()
   } else { // no more memory for deques
     fiber_to_resume = w->l->scheduling_fiber;
   }
+
+  // Going back to steal: try the producer first.
+  if (fiber_to_resume == w->l->scheduling_fiber
+      && producer && producer != w && g->help_producer)
+    w->l->help_target = producer;
   cilk_fiber_suspend_self_and_resume_other(current_fiber,
                                            fiber_to_resume);
+
+  // Resumed, possibly on another worker.
+  self->priority = 0;
+  if (reserved)
+    __atomic_sub_fetch(&g->suspended_in_get, 1, __ATOMIC_SEQ_CST);
+}
+
+// Takes one of the g->max_suspended places, if there is one left.
+static int reserve_suspend(global_state_t *g)
+{
+  int n = __atomic_load_n(&g->suspended_in_get, __ATOMIC_SEQ_CST);
+  while (n < g->max_suspended) {
+    if (__atomic_compare_exchange_n(&g->suspended_in_get, &n, n + 1, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+      return 1;
+  }
+  return 0;
+}
+
+// Spins between looks at the cap while waiting in place.
+#define WAIT_RECHECK_SPINS 256
+
+// What may_suspend waits for in place. A future is ready once *count
+// goes negative or, if count is NULL, once *slot == ready. A join (see
+// __cilkrts_join_wait) is done once its count of puts, less the hold,
+// plus join_ready, the futures that were put before it registered,
+// reaches need.
+typedef struct wait_target {
+  volatile int *count;
+  void *volatile *slot;
+  void *ready;
+  __cilkrts_join *join;
+  int join_ready;
+} wait_target;
+
+static inline int wait_done(const wait_target *t)
+{
+  if (t->join)
+    return t->join->state - __CILKRTS_JOIN_HOLD + t->join_ready >= t->join->need;
+  if (t->count)
+    return *t->count < 0;
+  return *t->slot == t->ready;
+}
+
+static int may_suspend(const wait_target *t)
+{
+  __cilkrts_worker *w = __cilkrts_get_tls_worker_fast();
+  global_state_t *g = w->g;
+
+  if (!g->max_suspended)
+    return 1;
+
+  // A get() that found its future put after reserving does not suspend;
+  // its place stays with this worker until the next suspension uses it.
+  if (w->l->suspend_reserved || reserve_suspend(g)) {
+    w->l->suspend_reserved = 1;
+    return 1;
+  }
+
+  // Someone has to be left to run the code that will put the future,
+  // so the last worker not waiting here suspends anyway, over the cap.
+  if (__atomic_add_fetch(&g->waiting_in_get, 1, __ATOMIC_SEQ_CST) >= g->P) {
+    __atomic_sub_fetch(&g->waiting_in_get, 1, __ATOMIC_SEQ_CST);
+    __atomic_add_fetch(&g->suspended_in_get, 1, __ATOMIC_SEQ_CST);
+    w->l->suspend_reserved = 1;
+#ifdef COLLECT_STEAL_STATS
+    w->l->ks_stats.suspends_over_cap++;
+#endif
+    return 1;
+  }
+
+#ifdef COLLECT_STEAL_STATS
+  w->l->ks_stats.get_waits++;
+#endif
+  // Our deque can still be stolen from while we wait, so make sure
+  // somebody is awake to do it.
+  parking_wake(g, 1);
+
+  int ret = 0;
+  int spins = 0;
+  while (!wait_done(t)) {
+    if (++spins < WAIT_RECHECK_SPINS) {
+      __cilkrts_short_pause();
+      continue;
+    }
+    spins = 0;
+    if (reserve_suspend(g)) {
+      w->l->suspend_reserved = 1;
+#ifdef COLLECT_STEAL_STATS
+      w->l->ks_stats.get_waits_suspended++;
+#endif
+      ret = 1;
+      break;
+    }
+    __cilkrts_yield();
+  }
+
+  __atomic_sub_fetch(&g->waiting_in_get, 1, __ATOMIC_SEQ_CST);
+  return ret;
+}
+
+int __cilkrts_may_suspend(volatile int *state)
+{
+  wait_target t = { state, NULL, NULL, NULL, 0 };
+  return may_suspend(&t);
+}
+
+int __cilkrts_may_suspend_until(void *volatile *slot, void *ready)
+{
+  wait_target t = { NULL, slot, ready, NULL, 0 };
+  return may_suspend(&t);
+}
+
+// The same test as may_suspend's. A negative budget means g->get_spins.
+static int spin_until_ready(volatile int *count, void *volatile *slot,
+                            void *ready, int spins)
+{
+  __cilkrts_worker *w = __cilkrts_get_tls_worker_fast();
+  if (spins < 0)
+    spins = w->g->get_spins;
+
+  while (count ? *count >= 0 : *slot != ready) {
+    if (spins-- <= 0) {
+#ifdef COLLECT_STEAL_STATS
+      w->l->ks_stats.get_spins_expired++;
+#endif
+      return 0;
+    }
+    __cilkrts_short_pause();
+  }
+#ifdef COLLECT_STEAL_STATS
+  w->l->ks_stats.get_spins_ready++;
+#endif
+  return 1;
+}
+
+int __cilkrts_spin_until_ready(volatile int *state, int spins)
+{
+  return spin_until_ready(state, NULL, NULL, spins);
+}
+
+int __cilkrts_spin_until_ready_slot(void *volatile *slot, void *ready, int spins)
+{
+  return spin_until_ready(NULL, slot, ready, spins);
 }
 
 void __cilkrts_make_resumable(void* _deque)
@@ -98,19 +285,17 @@ void __cilkrts_make_resumable(void* _deque)
          || !cilk_fiber_is_resumable(deque_to_resume->fiber));
 
   int previously_owned = 0;
-  __cilkrts_worker volatile* victim = deque_to_resume->worker;
+  __cilkrts_worker *victim = lock_pool_owner(w, deque_to_resume);
   if (victim) { 
+    previously_owned = 1;
+    deque_pool_remove(&victim->l->suspended_deques, deque_to_resume);
+    CILK_ASSERT(deque_to_resume->self == INVALID_DEQUE_INDEX);
+    deque_to_resume->resumable = 1;
+    __cilkrts_mutex_unlock(w, &victim->l->lock);
 
-    __cilkrts_mutex_lock(w, &victim->l->lock); {
-      if (deque_to_resume->worker) { 
-        previously_owned = 1;
-        deque_pool_remove(&victim->l->suspended_deques, deque_to_resume);
-        CILK_ASSERT(deque_to_resume->self == INVALID_DEQUE_INDEX);
-        deque_to_resume->resumable = 1;
-        deque_pool_add(victim, &victim->l->resumable_deques, deque_to_resume);
-      }
-      
-    } __cilkrts_mutex_unlock(w, &victim->l->lock);
+    // No one else can see the deque until it is published, so the
+    // push itself does not need the victim's lock.
+    deque_queue_push(victim, &victim->l->resumable_deques, deque_to_resume);
   }
 
 
@@ -119,8 +304,11 @@ void __cilkrts_make_resumable(void* _deque)
               deque_to_resume, victim->self);
   } else {
 
-    __cilkrts_worker *victim = NULL;
-    if (w->g->total_workers > 1) {
+    // Send the deque back to the socket where its stack was last
+    // used, if we know where that is.
+    __cilkrts_worker *victim =
+      worker_topology_pick_on_socket(w, deque_to_resume->socket);
+    if (!victim && w->g->total_workers > 1) {
       int victim_idx = myrand(w) % (w->g->total_workers);
       int victim2_idx = myrand(w) % (w->g->total_workers - 1);
       if (victim2_idx >= victim_idx) victim2_idx++;
@@ -131,21 +319,190 @@ void __cilkrts_make_resumable(void* _deque)
       if (victim->l->resumable_deques.size > potential_victim->l->resumable_deques.size) {
           victim = potential_victim;
       }
-    } else {
+    } else if (!victim) {
       victim = w;
     }
 
     CILK_ASSERT(deque_to_resume->self == INVALID_DEQUE_INDEX);
     deque_to_resume->resumable = 1;
-    deque_to_resume->worker = victim;
-    __cilkrts_mutex_lock(w, &victim->l->lock);
-    deque_pool_add(victim, &victim->l->resumable_deques, deque_to_resume);
-    __cilkrts_mutex_unlock(w, &victim->l->lock);
+    deque_queue_push(victim, &victim->l->resumable_deques, deque_to_resume);
 
     DEQUE_LOG("(w: %i) adding resumable free deque %p to resumables for %i\n",
             w->self, deque_to_resume, victim->self);
   }
 
+  // The push was a seq_cst atomic, so a worker that is just going to
+  // sleep either sees the deque or is counted in parked_workers.
+  parking_wake(w->g, 1);
+
+}
+
+void __cilkrts_make_resumable_chain(void* _deque, int remaining)
+{
+  deque *deque_to_resume = (deque*) _deque;
+
+  CILK_ASSERT(remaining >= 0);
+  CILK_ASSERT(deque_to_resume->resume_chain == 0);
+  deque_to_resume->resume_chain = remaining;
+  __cilkrts_make_resumable(deque_to_resume);
+}
+
+static inline int is_join_link(__cilkrts_deque_link *link)
+{
+  return ((uintptr_t) link->d & __CILKRTS_JOIN_TAG) != 0;
+}
+
+static void join_release(__cilkrts_join *j, int refs)
+{
+  if (refs && __atomic_sub_fetch(&j->refs, refs, __ATOMIC_SEQ_CST) == 0)
+    __cilkrts_free(j);
+}
+
+// Counts in one put for the join at link, which the caller has taken
+// off a list. Returns the join's deque if this put is the one it was
+// waiting for. The join may be freed here, so read anything needed
+// from link first.
+static void* join_arrive(__cilkrts_deque_link *link)
+{
+  __cilkrts_join *j =
+    (__cilkrts_join*) ((uintptr_t) link->d & ~(uintptr_t) __CILKRTS_JOIN_TAG);
+  void *d = NULL;
+
+  if (__atomic_fetch_add(&j->state, 1, __ATOMIC_SEQ_CST) == j->need - 1)
+    d = j->deque;
+  join_release(j, 1);
+  return d;
+}
+
+// Waits for the link after this one, if there are more to take.
+static inline __cilkrts_deque_link* next_link(__cilkrts_deque_link *link, int n)
+{
+  if (n <= 1)
+    return NULL;
+  while (!link->next);
+  return link->next;
+}
+
+void __cilkrts_make_resumable_links(__cilkrts_deque_link *link, int n)
+{
+  // Joins are taken here one by one; the first real deque carries the
+  // rest of the list as a chain, as before.
+  while (n > 0) {
+    if (!is_join_link(link)) {
+      __cilkrts_make_resumable_chain(link->d, n - 1);
+      return;
+    }
+    __cilkrts_deque_link *next = next_link(link, n);
+    void *d = join_arrive(link);
+    if (d)
+      __cilkrts_make_resumable(d);
+    link = next;
+    n--;
+  }
+}
+
+// Makes the n waiters from link on resumable, for a deque that was
+// just taken off a resumable queue carrying them as its chain. Rather
+// than handing the whole rest of the list to the next deque, which
+// would take n hand-offs in a row, we split it in half and give each
+// half to its first deque, to be split again when that is taken. So
+// the last of n waiters is woken after O(log n) hand-offs, and the
+// hand-offs spread over whichever workers take the deques. Finding the
+// second half walks the first, which is much cheaper than a resume.
+static void hand_off_links(__cilkrts_deque_link *link, int n)
+{
+  int first = (n + 1) / 2;
+  __cilkrts_deque_link *rest = NULL;
+
+  // Read this before anything in the first half is resumed and reuses
+  // its link.
+  if (n > first) {
+    rest = link;
+    for (int i = 0; i < first; i++) {
+      while (!rest->next);
+      rest = rest->next;
+    }
+  }
+
+  __cilkrts_make_resumable_links(link, first);
+  if (rest)
+    __cilkrts_make_resumable_links(rest, n - first);
+}
+
+void* __cilkrts_take_waiter_links(__cilkrts_deque_link *link, int n)
+{
+  while (n > 0) {
+    __cilkrts_deque_link *next = next_link(link, n);
+    void *d = is_join_link(link) ? join_arrive(link) : link->d;
+    n--;
+    if (d) {
+      if (n > 0)
+        __cilkrts_make_resumable_links(next, n);
+      return d;
+    }
+    link = next;
+  }
+  return NULL;
+}
+
+__cilkrts_join* __cilkrts_join_create(int n, int need)
+{
+  CILK_ASSERT(n > 0 && need > 0 && need <= n);
+
+  __cilkrts_join *j = (__cilkrts_join*)
+    __cilkrts_malloc(sizeof(__cilkrts_join) + (n - 1) * sizeof(__cilkrts_deque_link));
+  if (!j)
+    __cilkrts_bug("Cilk: could not allocate a join on %d futures\n", n);
+
+  j->deque = __cilkrts_get_deque();
+  j->n = n;
+  j->need = need;
+  j->state = __CILKRTS_JOIN_HOLD;
+  j->refs = n + 1;
+  for (int i = 0; i < n; i++) {
+    j->links[i].d = (void*) ((uintptr_t) j | __CILKRTS_JOIN_TAG);
+    j->links[i].next = NULL;
+  }
+  return j;
+}
+
+void __cilkrts_join_wait(__cilkrts_join *j, int registered, int ready)
+{
+  CILK_ASSERT(registered + ready == j->n);
+
+  // Links that never went into a list will not be taken.
+  join_release(j, j->n - registered);
+
+  // The cap applies as for get(). Waiting in place happens with the
+  // hold still set, so no put can try to resume us meanwhile.
+  if (ready < j->need) {
+    wait_target t = { NULL, NULL, NULL, j, ready };
+    may_suspend(&t);
+  }
+
+  // Puts seen so far could not have woken us while the hold was set;
+  // from here on, only the one that brings the count to need does.
+  int put = __atomic_add_fetch(&j->state, ready - __CILKRTS_JOIN_HOLD,
+                               __ATOMIC_SEQ_CST);
+  if (put < j->need)
+    __cilkrts_suspend_deque_on(NULL);
+
+  join_release(j, 1);
+}
+
+void __cilkrts_drop_waiter_links(__cilkrts_deque_link *link, int n)
+{
+  while (n > 0) {
+    __cilkrts_deque_link *next = next_link(link, n);
+    if (!is_join_link(link))
+      __cilkrts_bug("Cilk: future destroyed with a deque waiting on it\n");
+    __cilkrts_join *j =
+      (__cilkrts_join*) ((uintptr_t) link->d & ~(uintptr_t) __CILKRTS_JOIN_TAG);
+    CILK_ASSERT(j->state >= j->need);
+    join_release(j, 1);
+    link = next;
+    n--;
+  }
 }
 
 #ifdef TRACK_FIBER_COUNT
@@ -169,18 +526,13 @@ void __cilkrts_resume_suspended(void* _deque, int enable_resume)
          || !cilk_fiber_is_resumable(deque_to_resume->fiber));
 
   int mugged = 0;
-  __cilkrts_worker volatile* victim = deque_to_resume->worker;
+  // At this point, the original owner is done accessing the deque
+  // But a thief may be trying to mug this deque
+  __cilkrts_worker *victim = lock_pool_owner(w, deque_to_resume);
   if (victim) { // deque hasn't been mugged yet
-
-    // At this point, the original owner is done accessing the deque
-    // But a thief may be trying to mug this deque
-    __cilkrts_mutex_lock(w, &victim->l->lock); {
-      if (deque_to_resume->worker) { // still muggable
-        mugged = 1;
-        deque_mug(w, deque_to_resume);
-      }
-      
-    } __cilkrts_mutex_unlock(w, &victim->l->lock);
+    mugged = 1;
+    deque_mug(w, deque_to_resume);
+    __cilkrts_mutex_unlock(w, &victim->l->lock);
   }
   /* w->l->mugged--; */
   /* CILK_ASSERT(w->l->mugged >= 0); */
@@ -222,7 +574,7 @@ void __cilkrts_resume_suspended(void* _deque, int enable_resume)
         deque_switch(w, deque_to_resume);
     } END_WITH_WORKER_LOCK(w);
 
-    deque_destroy(to_destroy);
+    deque_destroy(w, to_destroy);
 
     deque_to_resume->fiber = NULL;
 
@@ -232,8 +584,7 @@ void __cilkrts_resume_suspended(void* _deque, int enable_resume)
     CILK_ASSERT(deque_to_resume->call_stack != NULL);
 
     cilk_fiber_take(fiber_to_resume);
-    if (w->l->future_fiber_pool_idx < (MAX_FUTURE_FIBERS_IN_POOL-1)) {
-        w->l->future_fiber_pool[++w->l->future_fiber_pool_idx] = current_fiber;
+    if (future_fiber_cache_put(w, &w->l->future_fibers, current_fiber)) {
 #ifdef TRACK_FIBER_COUNT
         decrement_fiber_count(w->g);
 #endif
@@ -265,10 +616,9 @@ void deque_pool_add(__cilkrts_worker *victim, deque_pool *p, deque *d)
 {
   __cilkrts_worker *w = __cilkrts_get_tls_worker();
   CILK_ASSERT(victim->l->lock.owner == w);
-  if (d->resumable)
-    CILK_ASSERT(&victim->l->resumable_deques == p);
-  else 
-    CILK_ASSERT(&victim->l->suspended_deques == p);
+  // Resumable deques go through deque_queue_push instead
+  CILK_ASSERT(!d->resumable);
+  CILK_ASSERT(&victim->l->suspended_deques == p);
 
   if (p->size == p->capacity) {
     size_t cap = 2 * p->capacity;
@@ -317,6 +667,67 @@ void deque_pool_remove(deque_pool *p, deque *d)
   d->worker = NULL;
 }
 
+int deque_pool_steal_batch(__cilkrts_worker *w, __cilkrts_worker *victim,
+                           deque *skip, int batch)
+{
+  CILK_ASSERT(victim->l->lock.owner == w);
+  deque_pool *from = &victim->l->suspended_deques;
+  deque_pool *to = &w->l->suspended_deques;
+
+  if (w == victim || batch == 1 || from->size < 2)
+    return 0;
+
+  // Whoever holds our lock may be stealing from us, so don't wait for it.
+  if (!__cilkrts_mutex_trylock(w, &w->l->lock))
+    return 0;
+
+  int i, stealable = 0;
+  for (i = 0; i < from->size; i++) {
+    deque *d = from->array[i];
+    if (d != skip && d->frame_ff && can_steal_from(victim, d))
+      stealable++;
+  }
+
+  // Batch size 0 means steal half.
+  int n = (batch == 0) ? stealable / 2 : batch - 1;
+  if (n > stealable)
+    n = stealable;
+
+  int moved = 0;
+  // Walk down from the end, so the deque that deque_pool_remove swaps
+  // into slot i has already been looked at.
+  for (i = from->size - 1; i >= 0 && moved < n; i--) {
+    deque *d = from->array[i];
+    if (d == skip || !d->frame_ff || !can_steal_from(victim, d))
+      continue;
+
+    // Don't go through deque_pool_remove/add: d->worker must never be
+    // NULL on the way, or __cilkrts_make_resumable would take d for a
+    // free deque.
+    int last = from->size - 1;
+    from->array[i] = from->array[last];
+    from->array[i]->self = i;
+    from->array[last] = NULL;
+    from->size--;
+
+    if (to->size == to->capacity)
+      resize(to, 2 * to->capacity);
+    d->self = to->size;
+    d->worker = w;
+    __asm__  volatile("": : :"memory");
+    to->array[to->size++] = d;
+    moved++;
+  }
+
+  deque_pool_validate(from, victim);
+  deque_pool_validate(to, w);
+  __cilkrts_mutex_unlock(w, &w->l->lock);
+
+  DEQUE_LOG("(w: %i) took %i suspended deques from %i\n",
+            w->self, moved, victim->self);
+  return moved;
+}
+
 void deque_pool_validate(deque_pool *p, __cilkrts_worker* w)
 {
   CILK_ASSERT(w->l->lock.owner != NULL);
@@ -329,3 +740,136 @@ void deque_pool_validate(deque_pool *p, __cilkrts_worker* w)
     }
   }
 }
+
+static void fifo_init(deque_fifo *f)
+{
+  f->stub.d = NULL;
+  f->stub.next = NULL;
+  f->head = f->tail = &f->stub;
+}
+
+void deque_queue_init(deque_queue *q)
+{
+  fifo_init(&q->normal);
+  fifo_init(&q->urgent);
+  q->urgent_streak = 0;
+  q->size = 0;
+  __cilkrts_mutex_init(&q->pop_lock);
+}
+
+void deque_queue_free(deque_queue *q)
+{
+  // There should be no resumable deques
+  CILK_ASSERT(q->size == 0);
+  __cilkrts_mutex_destroy(0, &q->pop_lock);
+}
+
+static void enqueue_link(deque_fifo *f, __cilkrts_deque_link *link)
+{
+  link->next = NULL;
+  __cilkrts_deque_link *prev = __atomic_exchange_n(&f->tail, link, __ATOMIC_SEQ_CST);
+  prev->next = link;
+}
+
+// Unlinks the oldest entry, or returns NULL if there is none (yet).
+// The caller holds the queue's pop_lock.
+static __cilkrts_deque_link* fifo_pop(deque_fifo *f)
+{
+  __cilkrts_deque_link *head = f->head;
+  __cilkrts_deque_link *next = head->next;
+
+  if (head == &f->stub) {
+    if (!next) // empty, or the first push has not linked yet
+      return NULL;
+    f->head = next;
+    head = next;
+    next = next->next;
+  }
+
+  if (!next) {
+    // head is the last linked entry. Put the stub behind it so that
+    // head can be unlinked. If a push is in flight, it will link
+    // head->next shortly.
+    if (head == f->tail)
+      enqueue_link(f, &f->stub);
+    while (!(next = head->next));
+  }
+
+  f->head = next;
+  return head;
+}
+
+void deque_queue_push(__cilkrts_worker *victim, deque_queue *q, deque *d)
+{
+  CILK_ASSERT(d->resumable);
+  CILK_ASSERT(d->self == INVALID_DEQUE_INDEX);
+
+  d->worker = victim;
+
+  // Count the deque before it becomes visible, so a consumer can
+  // never take the size below zero.
+  __atomic_fetch_add(&q->size, 1, __ATOMIC_SEQ_CST);
+  if (d->priority > 0 && victim->g->priority_burst > 0)
+    enqueue_link(&q->urgent, &d->resume_link);
+  else
+    enqueue_link(&q->normal, &d->resume_link);
+
+  DEQUE_LOG("(w: %i) queued resumable deque %p on %i\n",
+            __cilkrts_get_tls_worker()->self, d, victim->self);
+}
+
+deque* deque_queue_pop(__cilkrts_worker *w, deque_queue *q)
+{
+  deque *d = NULL;
+
+  if (q->size == 0)
+    return NULL;
+
+  // Another consumer is already taking from this queue; let the
+  // caller move on, just as if a worker trylock had failed.
+  if (!__cilkrts_mutex_trylock(w, &q->pop_lock))
+    return NULL;
+
+  __cilkrts_deque_link *link = NULL;
+  if (q->urgent_streak >= w->g->priority_burst
+      && (link = fifo_pop(&q->normal))) {
+#ifdef COLLECT_STEAL_STATS
+    if (q->urgent_streak > 0)
+      w->l->ks_stats.priority_overrides++;
+#endif
+    q->urgent_streak = 0;
+  } else if ((link = fifo_pop(&q->urgent))) {
+    q->urgent_streak++;
+#ifdef COLLECT_STEAL_STATS
+    w->l->ks_stats.urgent_resumes++;
+#endif
+  } else if ((link = fifo_pop(&q->normal))) {
+    q->urgent_streak = 0;
+  } else {
+    goto done;
+  }
+
+  d = (deque*) link->d;
+  __atomic_fetch_sub(&q->size, 1, __ATOMIC_SEQ_CST);
+
+  CILK_ASSERT(d->resumable);
+  CILK_ASSERT(d->fiber);
+  d->worker = NULL;
+  d->call_stack->worker = w;
+
+  DEQUE_LOG("(w: %i) took resumable deque %p\n", w->self, d);
+
+done:
+  __cilkrts_mutex_unlock(w, &q->pop_lock);
+
+  if (d && d->resume_chain) {
+    // Pass the rest of the waiter list on before d runs again and
+    // reuses its link for another future.
+    int remaining = d->resume_chain;
+    d->resume_chain = 0;
+    while (!d->link.next);
+    hand_off_links(d->link.next, remaining);
+  }
+
+  return d;
+}
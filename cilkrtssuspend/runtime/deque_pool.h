@@ -5,6 +5,7 @@
 
 #include "deque.h"
 #include "cilk_fiber.h"
+#include "worker_mutex.h"
 
 // This is just a simple vector
 typedef struct deque_pool_s {
@@ -19,4 +20,43 @@ void deque_pool_add(__cilkrts_worker *victim, deque_pool *p, deque *d);
 void deque_pool_remove(deque_pool *p, deque *d);
 void deque_pool_validate(deque_pool *p, __cilkrts_worker *w);
 
+// Moves some of victim's stealable suspended deques (not skip) into
+// w's pool, so that other thieves can find them there. batch is the
+// most a thief takes in one steal, counting the frame it steals
+// itself; 0 means half of what the victim has, and 1 moves nothing.
+// The caller holds victim's lock; w's lock is only tried. Returns how
+// many deques were moved.
+int deque_pool_steal_batch(__cilkrts_worker *w, __cilkrts_worker *victim,
+                           deque *skip, int batch);
+
+// One FIFO list of a deque_queue.
+typedef struct deque_fifo_s {
+	__cilkrts_deque_link *volatile tail; // producer end
+	__cilkrts_deque_link *head;          // consumer end, guarded by pop_lock
+	__cilkrts_deque_link stub;
+} deque_fifo;
+
+// FIFO queue of resumable deques, linked through deque->resume_link.
+// Any worker may push without locking (an atomic exchange on the
+// tail, as in __cilkrts_insert_deque_into_list). Consumers only
+// contend on pop_lock, never on the owning worker's lock, and always
+// take the oldest entry.
+//
+// Deques that were waiting on a future with a priority above 0 go on
+// a second list, which consumers take from first. So that the others
+// still move, after g->priority_burst of those in a row the oldest
+// normal one goes next.
+typedef struct deque_queue_s {
+	deque_fifo normal;
+	deque_fifo urgent;
+	struct mutex pop_lock;
+	int urgent_streak;    // urgent pops in a row, guarded by pop_lock
+	volatile size_t size; // may briefly lag behind the list contents
+} deque_queue;
+
+void deque_queue_init(deque_queue *q);
+void deque_queue_free(deque_queue *q);
+void deque_queue_push(__cilkrts_worker *victim, deque_queue *q, deque *d);
+deque* deque_queue_pop(__cilkrts_worker *w, deque_queue *q);
+
 #endif
@@ -0,0 +1,152 @@
+#include <string.h> // memcpy, memmove, memset
+
+#include "future_fiber_cache.h"
+#include "local_state.h"
+#include "scheduler.h" // myrand
+#include "cilk_malloc.h"
+#include "bug.h"
+
+#define MIN_CAPACITY 8
+
+static void grow(future_fiber_cache *c, int want)
+{
+  int cap = c->capacity ? c->capacity : MIN_CAPACITY;
+  while (cap < want)
+    cap *= 2;
+  if (cap > c->high_water)
+    cap = c->high_water;
+  if (cap <= c->capacity)
+    return;
+
+  cilk_fiber **new_array = (cilk_fiber**) __cilkrts_malloc(cap * sizeof(cilk_fiber*));
+
+  if (!new_array)
+    __cilkrts_bug("W%d could not grow future fiber cache to capacity %d\n",
+                  __cilkrts_get_tls_worker()->self, cap);
+
+  if (c->fibers) {
+    memcpy(new_array, c->fibers, c->size * sizeof(cilk_fiber*));
+    __cilkrts_free(c->fibers);
+  }
+  c->fibers = new_array;
+  c->capacity = cap;
+}
+
+void future_fiber_cache_init(future_fiber_cache *c, int high_water)
+{
+  memset(c, 0, sizeof(future_fiber_cache));
+  c->high_water = high_water;
+  c->low_water = high_water / 2;
+  __cilkrts_mutex_init(&c->spare_lock);
+}
+
+void future_fiber_cache_destroy(__cilkrts_worker *w, future_fiber_cache *c)
+{
+  for (int i = 0; i < c->size; i++)
+    cilk_fiber_remove_reference(c->fibers[i], NULL);
+  for (int i = 0; i < c->spare_size; i++)
+    cilk_fiber_remove_reference(c->spare[i], NULL);
+
+  __cilkrts_free(c->fibers);
+  __cilkrts_free(c->spare);
+  c->fibers = c->spare = NULL;
+  c->size = c->capacity = c->spare_size = 0;
+  __cilkrts_mutex_destroy(w, &c->spare_lock);
+}
+
+int future_fiber_cache_make_room(__cilkrts_worker *w, future_fiber_cache *c)
+{
+  if (c->high_water == 0)
+    return 0;
+
+  if (c->capacity < c->high_water) {
+    grow(c, c->size + 1);
+    return 1;
+  }
+
+  // Full: keep the newest low_water fibers and spill the older ones.
+  int n = c->size - c->low_water;
+  int i;
+
+  // Spares may sit idle for a while, so trim their stacks.  This has
+  // to happen before a thief can see them.
+  for (i = 0; i < n; i++)
+    cilk_fiber_recycle_stack(c->fibers[i]);
+
+  i = 0;
+
+  __cilkrts_mutex_lock(w, &c->spare_lock); {
+    if (!c->spare) {
+      c->spare = (cilk_fiber**) __cilkrts_malloc(c->high_water * sizeof(cilk_fiber*));
+      if (!c->spare)
+        __cilkrts_bug("W%d could not allocate spare future fibers\n", w->self);
+    }
+    for (; i < n && c->spare_size < c->high_water; i++)
+      c->spare[c->spare_size++] = c->fibers[i];
+  } __cilkrts_mutex_unlock(w, &c->spare_lock);
+
+  // Nobody has come for the spares; let the pool have the rest.
+  for (; i < n; i++)
+    cilk_fiber_remove_reference(c->fibers[i], &w->l->fiber_pool);
+
+  memmove(c->fibers, c->fibers + n, c->low_water * sizeof(cilk_fiber*));
+  c->size = c->low_water;
+  return 1;
+}
+
+// Moves fibers from from->spare into c, which must be empty. We take
+// back as many of our own spares as we would keep after a spill, but
+// only half of another worker's.
+static int take_spares(__cilkrts_worker *w, future_fiber_cache *c,
+                       future_fiber_cache *from)
+{
+  CILK_ASSERT(c->size == 0);
+
+  if (from->spare_size == 0)
+    return 0;
+
+  if (from == c)
+    __cilkrts_mutex_lock(w, &from->spare_lock);
+  else if (!__cilkrts_mutex_trylock(w, &from->spare_lock))
+    return 0;
+
+  int n = (from == c) ? from->spare_size : (from->spare_size + 1) / 2;
+  int max = (c->low_water > 0) ? c->low_water : 1;
+  if (n > max)
+    n = max;
+
+  if (n > 0) {
+    grow(c, n);
+    from->spare_size -= n;
+    memcpy(c->fibers, from->spare + from->spare_size, n * sizeof(cilk_fiber*));
+    c->size = n;
+  }
+
+  __cilkrts_mutex_unlock(w, &from->spare_lock);
+  return n;
+}
+
+cilk_fiber* future_fiber_cache_refill(__cilkrts_worker *w, future_fiber_cache *c)
+{
+  if (c->high_water > 0) {
+    if (take_spares(w, c, c)) {
+#ifdef COLLECT_STEAL_STATS
+      c->hits++;
+#endif
+      return c->fibers[--c->size];
+    }
+
+    __cilkrts_worker *victim = w->g->workers[myrand(w) % w->g->total_workers];
+    if (victim != w && take_spares(w, c, &victim->l->future_fibers)) {
+#ifdef COLLECT_STEAL_STATS
+      c->steals++;
+#endif
+      return c->fibers[--c->size];
+    }
+  }
+
+#ifdef COLLECT_STEAL_STATS
+  c->misses++;
+#endif
+  return cilk_fiber_allocate(&w->l->fiber_pool);
+}
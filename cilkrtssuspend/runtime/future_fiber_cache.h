@@ -0,0 +1,70 @@
+#ifndef INCLUDED_FUTURE_FIBER_CACHE_DOT_H
+#define INCLUDED_FUTURE_FIBER_CACHE_DOT_H
+
+#include <stdint.h>
+
+#include "rts-common.h"
+#include "cilk_fiber.h"
+#include "worker_mutex.h"
+
+__CILKRTS_BEGIN_EXTERN_C
+
+// Per-worker cache of fibers for running futures on.
+//
+// The owner pushes and pops at the top of fibers[] without locking.
+// The cache starts out empty and grows on demand, up to high_water
+// entries. When it is full, the oldest fibers above low_water are moved
+// to spare, where workers that miss in their own cache can steal them.
+// Fibers that do not fit in spare either go back to the fiber pool.
+typedef struct future_fiber_cache_s {
+	cilk_fiber **fibers;
+	int size;
+	int capacity;
+	int high_water;
+	int low_water;
+
+	struct mutex spare_lock;
+	cilk_fiber **spare; // guarded by spare_lock
+	volatile int spare_size;
+
+#ifdef COLLECT_STEAL_STATS
+	uint64_t hits;   // found a fiber in our own cache (or spare)
+	uint64_t steals; // took fibers from another worker's spare
+	uint64_t misses; // had to allocate a new fiber
+#endif
+} future_fiber_cache;
+
+void future_fiber_cache_init(future_fiber_cache *c, int high_water);
+void future_fiber_cache_destroy(__cilkrts_worker *w, future_fiber_cache *c);
+
+// Slow paths of the functions below
+cilk_fiber* future_fiber_cache_refill(__cilkrts_worker *w, future_fiber_cache *c);
+int future_fiber_cache_make_room(__cilkrts_worker *w, future_fiber_cache *c);
+
+static inline
+cilk_fiber* future_fiber_cache_get(__cilkrts_worker *w, future_fiber_cache *c)
+{
+	if (__builtin_expect(c->size > 0, 1)) {
+#ifdef COLLECT_STEAL_STATS
+		c->hits++;
+#endif
+		return c->fibers[--c->size];
+	}
+	return future_fiber_cache_refill(w, c);
+}
+
+// Returns 0 if the cache is disabled, in which case the caller must
+// give the fiber back to the pool itself.
+static inline
+int future_fiber_cache_put(__cilkrts_worker *w, future_fiber_cache *c, cilk_fiber *f)
+{
+	if (__builtin_expect(c->size == c->capacity, 0)
+	    && !future_fiber_cache_make_room(w, c))
+		return 0;
+	c->fibers[c->size++] = f;
+	return 1;
+}
+
+__CILKRTS_END_EXTERN_C
+
+#endif
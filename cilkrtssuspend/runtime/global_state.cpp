@@ -56,6 +56,7 @@
 #include "cilk_malloc.h"
 #include "record-replay.h"
 #include "pedigrees.h"
+#include "deque.h"
 
 #include <algorithm>  // For max()
 #include <cstring>
@@ -220,6 +221,31 @@ namespace {
     return __CILKRTS_SET_PARAM_SUCCESS;
 	}
 
+	// Stores the enum suspend_policy_t named by the null-terminated string
+	// at 'val' into 'out'.  Returns '__CILKRTS_SET_PARAM_SUCCESS' if 'val'
+	// is "proactive", "parsimonious" or "hybrid" (or the number of one of
+	// them) and '__CILKRTS_SET_PARAM_INVALID' otherwise.
+	template <typename CHAR_T>
+	int store_suspend_policy(int *out, const CHAR_T *val)
+	{
+    static const char* const s_proactive    = "proactive";
+    static const char* const s_parsimonious = "parsimonious";
+    static const char* const s_hybrid       = "hybrid";
+
+    if (val == 0)
+			return __CILKRTS_SET_PARAM_INVALID;
+
+    if (strmatch(s_proactive, val))
+			*out = SUSPEND_PROACTIVE;
+    else if (strmatch(s_parsimonious, val))
+			*out = SUSPEND_PARSIMONIOUS;
+    else if (strmatch(s_hybrid, val))
+			*out = SUSPEND_HYBRID;
+    else
+			return store_int(out, val, (int) SUSPEND_PROACTIVE, (int) SUSPEND_HYBRID);
+    return __CILKRTS_SET_PARAM_SUCCESS;
+	}
+
 	// Implementaton of cilkg_set_param templatized on character type.
 	// Windows will instantiate with both char and wchar_t.
 	// Note that g must have its user settable values set, but need not be fully
@@ -232,6 +258,20 @@ namespace {
     static const char* const s_max_user_workers = "max user workers";
     static const char* const s_local_stacks     = "local stacks";
     static const char* const s_shared_stacks    = "shared stacks";
+    static const char* const s_future_fibers    = "future fibers";
+    static const char* const s_stack_recycle    = "stack recycle";
+    static const char* const s_stack_recycle_lazy = "stack recycle lazy";
+    static const char* const s_steal_core_pct   = "steal core pct";
+    static const char* const s_steal_socket_pct = "steal socket pct";
+    static const char* const s_steal_batch      = "steal batch";
+    static const char* const s_park_spins       = "park spins";
+    static const char* const s_park_timeout     = "park timeout";
+    static const char* const s_suspend_policy   = "suspend policy";
+    static const char* const s_suspend_depth    = "suspend depth";
+    static const char* const s_max_suspended    = "max suspended";
+    static const char* const s_help_producer    = "help producer";
+    static const char* const s_get_spins        = "get spins";
+    static const char* const s_priority_burst   = "priority burst";
     static const char* const s_nstacks          = "nstacks";
     static const char* const s_stack_size       = "stack size";
 		static const char* const s_ped_seed         = "ped seed";
@@ -310,6 +350,101 @@ namespace {
         // details.
         return store_int(&g->global_fiber_pool_size, value, 0, 128);
 			}
+    else if (strmatch(param, s_future_fibers))
+			{
+        // Number of fibers each worker may keep cached for running
+        // futures.  The cache starts empty and grows up to this size.
+        // 0 disables it.  Can only be set before the runtime starts.
+        if (cilkg_singleton_ptr)
+					return __CILKRTS_SET_PARAM_LATE;
+        return store_int(&g->future_fiber_cache_size, value, 0, 1 << 16);
+			}
+    else if (strmatch(param, s_stack_recycle))
+			{
+        // Bytes at the top of each stack to keep resident when its
+        // fiber goes back to a pool.  0 turns stack recycling off.
+        return store_int<size_t>(&g->stack_recycle_size, value, 0, INT_MAX);
+			}
+    else if (strmatch(param, s_stack_recycle_lazy))
+			{
+        // Whether recycled stack pages are freed lazily (MADV_FREE).
+        return store_bool(&g->stack_recycle_lazy, value);
+			}
+    else if (strmatch(param, s_steal_core_pct))
+			{
+        // Percent of steals that try a worker on the same core, when
+        // workers are pinned.  Can only be set before the runtime starts.
+        if (cilkg_singleton_ptr)
+					return __CILKRTS_SET_PARAM_LATE;
+        return store_int(&g->steal_core_pct, value, 0, 100);
+			}
+    else if (strmatch(param, s_steal_socket_pct))
+			{
+        // Percent of steals that try another worker on the same socket,
+        // when workers are pinned.  Can only be set before the runtime
+        // starts.
+        if (cilkg_singleton_ptr)
+					return __CILKRTS_SET_PARAM_LATE;
+        return store_int(&g->steal_socket_pct, value, 0, 100);
+			}
+    else if (strmatch(param, s_steal_batch))
+			{
+        // Most deques a thief takes from one victim at a time.  0 means
+        // half of the victim's, 1 turns batch stealing off.
+        return store_int(&g->steal_batch, value, 0, 1 << 16);
+			}
+    else if (strmatch(param, s_park_spins))
+			{
+        // Failed steals before an idle worker goes to sleep.  0 keeps
+        // idle workers spinning.
+        return store_int(&g->park_spins, value, 0, INT_MAX);
+			}
+    else if (strmatch(param, s_park_timeout))
+			{
+        // Longest an idle worker sleeps, in microseconds, before it
+        // looks for work again.
+        return store_int(&g->park_timeout_us, value, 1, 1000000);
+			}
+    else if (strmatch(param, s_suspend_policy))
+			{
+        // What to do with a deque that blocks in get(): "proactive",
+        // "parsimonious" or "hybrid".  Takes effect at the next
+        // suspension, so it may be changed at any time.
+        return store_suspend_policy(&g->suspend_policy, value);
+			}
+    else if (strmatch(param, s_suspend_depth))
+			{
+        // With the hybrid policy, the most frames a blocked deque may
+        // have left to steal and still stay with its worker.
+        return store_int(&g->suspend_depth, value, 0, INT_MAX);
+			}
+    else if (strmatch(param, s_max_suspended))
+			{
+        // Sets the most deques that may be suspended in get() at once.
+        // Past it, get() waits for the future without suspending.  0
+        // means unlimited, the default.  Fibers running future bodies
+        // are not counted.
+        if (cilkg_singleton_ptr)
+					return __CILKRTS_SET_PARAM_LATE;
+        return store_int(&g->max_suspended, value, 0, INT_MAX);
+			}
+    else if (strmatch(param, s_help_producer))
+			{
+        // When a get() blocks, steal from the future's producer before
+        // anyone else.  Off by default.
+        return store_bool(&g->help_producer, value);
+			}
+    else if (strmatch(param, s_get_spins))
+			{
+        // Sets how long get_or_spin() spins before it suspends.
+        return store_int(&g->get_spins, value, 0, INT_MAX);
+			}
+    else if (strmatch(param, s_priority_burst))
+			{
+        // Sets how many high-priority resumable deques go ahead of the
+        // others in a row.  0 turns priorities off.
+        return store_int(&g->priority_burst, value, 0, INT_MAX);
+			}
     else if (strmatch(param, s_nstacks))
 			{
         // Sets the maximum number of stacks permitted at one time.  If the
@@ -423,6 +558,18 @@ global_state_t* cilkg_get_user_settable_values()
 			g->fiber_pool_size          = 64;   // Arbitrary default
         
 			g->global_fiber_pool_size   = 6 * 3* g->P;  // Arbitrary default
+			g->future_fiber_cache_size  = 128;  // Filled lazily
+			g->steal_core_pct           = 20;
+			g->steal_socket_pct         = 60;
+			g->steal_batch              = 1;    // Off
+			g->park_spins               = 2048;
+			g->park_timeout_us          = 1000;
+			g->suspend_policy           = SUSPEND_PROACTIVE;
+			g->suspend_depth            = 16;
+			g->max_suspended            = 0;    // Unlimited
+			g->help_producer            = 0;
+			g->get_spins                = 256;
+			g->priority_burst           = 8;
 			// 3*P was the default size of the worker array (including
 			// space for extra user workers).  This parameter was chosen
 			// to match previous versions of the runtime.
@@ -486,6 +633,66 @@ global_state_t* cilkg_get_user_settable_values()
 				// it looks to see whether it should suspend itself.
 				store_int<unsigned>(&g->max_steal_failures, envstr, 1, INT_MAX);
 
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_FUTURE_FIBERS"))
+				// Set the most fibers a worker keeps cached for futures.
+				store_int(&g->future_fiber_cache_size, envstr, 0, 1 << 16);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_STACK_RECYCLE"))
+				// Set how much of each pooled stack stays resident.
+				store_int<size_t>(&g->stack_recycle_size, envstr, 0, INT_MAX);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_STACK_RECYCLE_LAZY"))
+				// Set whether recycled stack pages are freed lazily.
+				store_bool(&g->stack_recycle_lazy, envstr);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_STEAL_CORE_PCT"))
+				// Set how often a pinned worker steals within its core.
+				store_int(&g->steal_core_pct, envstr, 0, 100);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_STEAL_SOCKET_PCT"))
+				// Set how often a pinned worker steals within its socket.
+				store_int(&g->steal_socket_pct, envstr, 0, 100);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_STEAL_BATCH"))
+				// Set how many deques a thief takes from one victim.
+				store_int(&g->steal_batch, envstr, 0, 1 << 16);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_PARK_SPINS"))
+				// Set how long an idle worker spins before it sleeps.
+				store_int(&g->park_spins, envstr, 0, INT_MAX);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_PARK_TIMEOUT"))
+				// Set the longest an idle worker sleeps (microseconds).
+				store_int(&g->park_timeout_us, envstr, 1, 1000000);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_SUSPEND_POLICY"))
+				// Set what happens to a deque that blocks in get().
+				store_suspend_policy(&g->suspend_policy, envstr);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_SUSPEND_DEPTH"))
+				// Set the deepest deque the hybrid policy keeps local.
+				store_int(&g->suspend_depth, envstr, 0, INT_MAX);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_MAX_SUSPENDED"))
+				// Set the most deques that may be suspended in get().
+				store_int(&g->max_suspended, envstr, 0, INT_MAX);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_HELP_PRODUCER"))
+				// Set whether a blocked get() helps the future's producer.
+				store_bool(&g->help_producer, envstr);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_GET_SPINS"))
+				// Set how long get_or_spin() spins before it suspends.
+				store_int(&g->get_spins, envstr, 0, INT_MAX);
+
+			if (cilkos_getenv(envstr, sizeof(envstr), "CILK_PRIORITY_BURST"))
+				// Set how far high-priority deques may jump the queue.
+				store_int(&g->priority_burst, envstr, 0, INT_MAX);
+
+			// Read the (undocumented) CILK_PINNING options.  Workers
+			// are not pinned unless it asks for it.
+			pinning_parse_options(&g->pin_options);
+
 			// Compute the total number of workers to allocate.  Subtract one from
 			// nworkers and user workers so that the first user worker isn't
 			// factored in twice.
@@ -587,6 +794,7 @@ global_state_t* cilkg_init_global_state()
 	__cilkrts_init_stats(&g->stats);
 
 	__cilkrts_frame_malloc_global_init(g);
+	deque_global_init(g);
 
 	g->Q = 0;
 	g->total_workers = cilkg_calc_total_workers();
@@ -65,6 +65,7 @@
 #include "cilk_fiber.h"
 #include "cilk_fiber_pool.h"
 #include "full_frame.h"
+#include "pinning.h"
 
 typedef struct deque deque; /// @todo{fix redefinition of deque in global_state.h}
 
@@ -84,6 +85,16 @@ enum record_replay_t {
 	REPLAY_LOG
 };
 
+/**
+ * What a worker does with a deque that blocks in get(); see
+ * deque_suspend.
+ */
+enum suspend_policy_t {
+	SUSPEND_PROACTIVE,    ///< Hand it to a random worker, go steal
+	SUSPEND_PARSIMONIOUS, ///< Keep it, and work from our own deques until none is left
+	SUSPEND_HYBRID        ///< Parsimonious unless the deque is empty or deep
+};
+
 /**
  * @brief Global state structure version.
  *
@@ -185,6 +196,94 @@ struct global_state_t { /* COMMON_PORTABLE */
 	/// USER SETTING: Global fiber pool size
 	int global_fiber_pool_size;
 
+	/// Unused deques that workers gave up when their own freelists got
+	/// long, protected by deque_freelist_lock.  See deque_alloc.
+	struct deque *deque_freelist;
+	int deque_freelist_size;
+	struct mutex deque_freelist_lock;
+
+	/// USER SETTING: Most fibers each worker keeps for running futures
+	int future_fiber_cache_size;
+
+	/// USER SETTING: Bytes at the top of a pooled fiber's stack that stay
+	/// resident.  Pages below that are given back to the OS when the
+	/// fiber returns to a pool.  0 (the default) turns this off.
+	__STDNS size_t stack_recycle_size;
+
+	/// USER SETTING: Give recycled stack pages back with MADV_FREE
+	/// rather than MADV_DONTNEED.  Cheaper, but the pages stay in RSS
+	/// until the system runs short of memory.  Off by default.
+	int stack_recycle_lazy;
+
+	/// UNDOCUMENTED: Options for pinning workers to hardware threads,
+	/// read from CILK_PINNING (e.g. "scatter" or "compact,verbose").
+	pin_options_t pin_options;
+
+	/// Where each worker is pinned, or NULL if workers are not pinned.
+	system_cpu_map* pin_map;
+
+	/// USER SETTING: Percent of steal attempts that go to a worker on
+	/// the same core, and to one on the same socket.  The rest go to any
+	/// worker.  Only used when workers are pinned.
+	int steal_core_pct;
+	int steal_socket_pct;
+
+	/// USER SETTING: Most deques a thief takes from one victim, counting
+	/// the one it steals from: extra suspended deques go to its pool,
+	/// extra resumable ones to its queue.  0 takes half of what the
+	/// victim has; 1, the default, turns batching off.
+	int steal_batch;
+
+	/// USER SETTING: Failed steals in a row before an idle system worker
+	/// parks (see parking.c); 0 never parks.
+	int park_spins;
+
+	/// USER SETTING: Longest a parked worker sleeps before it looks for
+	/// work again, in microseconds.  Bounds the wake-up latency for work
+	/// nobody tells it about.
+	int park_timeout_us;
+
+	/// USER SETTING: What happens to a deque that blocks in get() (an
+	/// enum suspend_policy_t), and for SUSPEND_HYBRID, the most frames
+	/// it may have left to steal and still be kept by its worker.  May
+	/// be changed at any time.
+	int suspend_policy;
+	int suspend_depth;
+
+	/// USER SETTING: Most deques that may be suspended in get() at once,
+	/// each pinning a fiber; 0 means no limit.  Past it, get() waits for
+	/// the future in place instead (see __cilkrts_may_suspend).  A place
+	/// is reserved atomically before each suspension, so the cap is
+	/// exceeded only by a worker that blocks while all P-1 others are
+	/// waiting in place; it suspends anyway, or nothing could run the
+	/// code that will put their futures.  Fibers running future bodies
+	/// are not counted: each live future body holds one whether or not
+	/// anything waits on it.  Fixed at startup.
+	int max_suspended;
+
+	/// USER SETTING: If set, a worker whose deque blocks in get() tries
+	/// first to steal from the worker that started the future's body.
+	/// May be changed at any time.
+	int help_producer;
+
+	/// USER SETTING: How long get_or_spin() spins on a future that is
+	/// not ready before it suspends, in pause instructions.  May be
+	/// changed at any time.
+	int get_spins;
+
+	/// USER SETTING: Most resumable deques with a priority a worker's
+	/// queue hands out in a row while others wait; then the oldest
+	/// other one goes.  0 ignores priorities.  May be changed at any
+	/// time.
+	int priority_burst;
+
+	/// Workers grouped by the socket they are pinned to: socket s has
+	/// socket_workers[socket_start[s]] up to socket_workers[socket_start[s+1]].
+	/// num_sockets is 0 when workers are not pinned.  See worker_topology.c.
+	int num_sockets;
+	int *socket_start;
+	struct __cilkrts_worker **socket_workers;
+
     #ifdef TRACK_FIBER_COUNT
     volatile uint64_t fiber_count;
     volatile uint64_t fiber_high_watermark;
@@ -286,6 +385,35 @@ struct global_state_t { /* COMMON_PORTABLE */
 	int ped_seed;
 	size_t big_prime;
 	size_t ped_compression_vec[256];
+
+	/**
+	 * @brief Buffer to keep the parking state below on its own cache
+	 * line.  parked_workers is read on every spawn that goes through the
+	 * runtime.
+	 */
+	char cache_buf_3[64];
+
+	/// Number of workers in parking_park()
+	volatile int parked_workers;
+
+	/// Futex word parked workers sleep on; parking_wake bumps it.
+	volatile int park_seq;
+
+	/// Set by parking_wake while its wake-up is pending, cleared by
+	/// the next worker to come out of (or go into) parking_park.
+	volatile int park_waking;
+
+	/**
+	 * @brief Buffer to keep the counts below, which are only kept when
+	 * max_suspended is set, off the parking line.
+	 */
+	char cache_buf_4[64];
+
+	/// Deques currently suspended in get(), or about to be
+	volatile int suspended_in_get;
+
+	/// Workers waiting in place in __cilkrts_may_suspend
+	volatile int waiting_in_get;
 };
 
 /**
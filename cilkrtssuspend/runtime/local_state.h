@@ -65,6 +65,7 @@
 #include "signal_node.h"
 #include "deque.h"
 #include "deque_pool.h"
+#include "future_fiber_cache.h"
 
 #include <setjmp.h>
 #include <stddef.h>
@@ -119,6 +120,22 @@ typedef struct kyles_steal_stats {
     uint64_t successful_steal_on_suspend;
     uint64_t deques_mugged_on_suspend;
     uint64_t deques_resumed;
+    uint64_t core_steal_attempts;   // victim chosen from our core
+    uint64_t socket_steal_attempts; // victim chosen from our socket
+    uint64_t batch_stolen_deques;   // extra deques taken along with a steal
+    uint64_t ltq_allocs;            // full-size LTQs allocated
+    uint64_t ltq_shrinks;           // suspended deques that gave theirs back
+    uint64_t ltq_kept_full;         // ...and those that had too much on them
+    uint64_t suspends_kept_local;   // suspended deques kept by their worker
+    uint64_t get_waits;             // get()s that waited in place (max suspended)
+    uint64_t get_waits_suspended;   // ...but suspended once there was room
+    uint64_t suspends_over_cap;     // suspended past the cap to avoid deadlock
+    uint64_t help_steal_attempts;   // steals aimed at a blocked get()'s producer
+    uint64_t help_steals;           // ...that got work
+    uint64_t get_spins_ready;       // get_or_spin()s that saw the future put
+    uint64_t get_spins_expired;     // ...and those that gave up and suspended
+    uint64_t urgent_resumes;        // resumable deques taken for their priority
+    uint64_t priority_overrides;    // others taken ahead of them (starvation guard)
 } kyles_steal_stats;
 
 #endif
@@ -242,7 +259,7 @@ struct local_state  /* COMMON_PORTABLE */
 
 	deque *active_deque;
 	deque_pool suspended_deques;
-	deque_pool resumable_deques;
+	deque_queue resumable_deques;
 
 	/**
 	 * Team on which this worker is a participant.  When a user worker enters,
@@ -298,10 +315,59 @@ struct local_state  /* COMMON_PORTABLE */
 	 */
 	cilk_fiber_pool fiber_pool;
 
-    int future_fiber_pool_idx;
-    #define MAX_FUTURE_FIBERS_IN_POOL (128)
-
-    cilk_fiber* future_fiber_pool[MAX_FUTURE_FIBERS_IN_POOL];
+    /**
+     * Fibers for running futures on, sized by g->future_fiber_cache_size.
+     * [local read/write, spares stolen under their own lock]
+     */
+    future_fiber_cache future_fibers;
+
+    /**
+     * Unused deques kept for reuse; see deque_alloc.
+     * [local read/write]
+     */
+    deque *deque_freelist;
+    int deque_freelist_size;
+
+    /**
+     * Unused full-size LTQs and fiber LTQs; see deque_switch.
+     * [local read/write]
+     */
+    void *ltq_cache;
+    int ltq_cache_size;
+    void *fiber_ltq_cache;
+    int fiber_ltq_cache_size;
+
+    /**
+     * Index of the socket this worker is pinned to, or -1 if workers
+     * are not pinned.  See worker_topology.c.
+     * [constant after init]
+     */
+    int socket;
+
+    /**
+     * Workers to try first when stealing: the first num_core_peers
+     * share this worker's core, the next num_socket_peers its socket.
+     * [constant after init]
+     */
+    int *steal_peers;
+    int num_core_peers;
+    int num_socket_peers;
+
+    /**
+     * Worker that was running the producer of a future this worker
+     * just blocked on, or NULL.  random_steal tries it once, before
+     * any other victim, when g->help_producer is set.
+     * [local read/write]
+     */
+    __cilkrts_worker *help_target;
+
+    /**
+     * Set when __cilkrts_may_suspend has reserved a place under
+     * g->max_suspended for the deque this worker is about to suspend;
+     * the suspension takes it over and gives it back on resume.
+     * [local read/write]
+     */
+    int suspend_reserved;
 
 	/**
 	 * The fiber for the scheduling stacks.
@@ -398,6 +464,8 @@ struct local_state  /* COMMON_PORTABLE */
     kyles_steal_stats ks_stats;
     uint64_t sync_suspend;
     uint64_t num_susp_empty;
+    uint64_t parks;        // times this worker went to sleep in parking_park
+    uint64_t park_wakeups; // ...and was woken up, rather than timing out
     #endif
 
 	/**
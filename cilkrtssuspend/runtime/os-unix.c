@@ -56,6 +56,8 @@
 #if defined __linux__
 #   include <sys/sysinfo.h>
 #   include <sys/syscall.h>
+#   include <linux/futex.h>
+#   include <time.h>
 
 #elif defined __APPLE__
 #   include <sys/sysctl.h>
@@ -503,6 +505,30 @@ COMMON_SYSDEP void __cilkrts_yield(void)
 #endif
 }
 
+COMMON_SYSDEP void cilkos_futex_wait(volatile int *addr, int val, int timeout_us)
+{
+#if defined(__linux__)
+	struct timespec ts;
+	ts.tv_sec = timeout_us / 1000000;
+	ts.tv_nsec = (timeout_us % 1000000) * 1000;
+	// EAGAIN (*addr != val), EINTR and ETIMEDOUT all just mean "go look
+	// again", so the result doesn't matter.
+	syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, &ts, NULL, 0);
+#else
+	// No futex; sleeping out the timeout still bounds the wake-up
+	// latency.
+	if (*addr == val)
+		usleep(timeout_us);
+#endif
+}
+
+COMMON_SYSDEP void cilkos_futex_wake(volatile int *addr, int n)
+{
+#if defined(__linux__)
+	syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+#endif
+}
+
 COMMON_SYSDEP __STDNS size_t cilkos_getenv(char* value, __STDNS size_t vallen,
                                            const char* varname)
 {
@@ -556,6 +582,20 @@ COMMON_SYSDEP void cilkos_warning(const char *fmt, ...)
 	fflush(stderr);
 }
 
+/*
+ * Print a message, prefixed with label, to stderr.
+ */
+COMMON_SYSDEP void cilkos_message(const char* label, const char *fmt, ...)
+{
+	va_list l;
+	fflush(NULL);
+	fprintf(stderr, "%s: ", label);
+	va_start(l, fmt);
+	vfprintf(stderr, fmt, l);
+	va_end(l);
+	fflush(stderr);
+}
+
 #ifdef __VXWORKS__
 #ifdef _WRS_KERNEL
 void cilkStart()
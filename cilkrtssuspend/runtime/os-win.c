@@ -344,6 +344,18 @@ COMMON_SYSDEP void __cilkrts_yield(void)
     Sleep(0);
 }
 
+COMMON_SYSDEP void cilkos_futex_wait(volatile int *addr, int val, int timeout_us)
+{
+    // Nothing to wait on here; sleeping out the timeout still bounds
+    // the wake-up latency.
+    if (*addr == val)
+        Sleep((timeout_us + 999) / 1000);
+}
+
+COMMON_SYSDEP void cilkos_futex_wake(volatile int *addr, int n)
+{
+}
+
 COMMON_SYSDEP __STDNS size_t cilkos_getenv(char* value, __STDNS size_t vallen,
                                            const char* varname)
 {
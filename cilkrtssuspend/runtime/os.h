@@ -170,6 +170,17 @@ COMMON_SYSDEP void __cilkrts_sleep(void); ///< Sleep briefly
 COMMON_SYSDEP void __cilkrts_yield(void); ///< Yield quantum 
 COMMON_SYSDEP void __cilkrts_idle(void);  ///< Idle
 
+/**
+ * @brief Sleep while *addr == val, until cilkos_futex_wake() is called
+ * on addr or timeout_us microseconds have passed.  May return early.
+ */
+COMMON_SYSDEP void cilkos_futex_wait(volatile int *addr, int val, int timeout_us);
+
+/**
+ * @brief Wake up to n threads sleeping in cilkos_futex_wait() on addr.
+ */
+COMMON_SYSDEP void cilkos_futex_wake(volatile int *addr, int n);
+
 /**
  * @brief Gets environment variable 'varname' and copy its value into 'value'.
  *
@@ -197,6 +208,11 @@ COMMON_SYSDEP void cilkos_error(const char *fmt, ...);
  */
 COMMON_SYSDEP void cilkos_warning(const char *fmt, ...);
 
+/**
+ * @brief Print a labeled message and return.
+ */
+COMMON_SYSDEP void cilkos_message(const char* label, const char *fmt, ...);
+
 /**
  * @brief Convert the user's specified stack size into a "reasonable"
  * value for the current OS.
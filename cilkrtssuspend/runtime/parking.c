@@ -0,0 +1,71 @@
+#include "parking.h"
+#include "local_state.h"
+#include "deque_pool.h"
+#include "signal_node.h"
+#include "os.h"
+
+// Is there anything we know how to find without any wake-up? Other
+// workers' suspended deques can be resized under us, so we only look
+// at our own, under our lock.
+static int work_visible(__cilkrts_worker *w)
+{
+  global_state_t *g = w->g;
+
+  if (g->work_done || w->l->next_frame_ff)
+    return 1;
+  if (w->l->signal_node && signal_node_should_wait(w->l->signal_node))
+    return 1; // let worker_runnable put us to sleep properly
+
+  for (int i = 0; i < g->total_workers; i++) {
+    if (g->workers[i]->l->resumable_deques.size > 0)
+      return 1;
+  }
+
+  int found = 0;
+  deque_pool *p = &w->l->suspended_deques;
+  __cilkrts_mutex_lock(w, &w->l->lock); {
+    for (int i = 0; i < p->size && !found; i++)
+      found = p->array[i]->frame_ff && can_steal_from(w, p->array[i]);
+  } __cilkrts_mutex_unlock(w, &w->l->lock);
+  return found;
+}
+
+int parking_park(__cilkrts_worker *w)
+{
+  global_state_t *g = w->g;
+  int seq = __atomic_load_n(&g->park_seq, __ATOMIC_SEQ_CST);
+
+  // Any wake-up still pending was for a bump we have already seen (or
+  // will be woken by), so let the next one through.
+  __atomic_store_n(&g->park_waking, 0, __ATOMIC_SEQ_CST);
+
+  __atomic_fetch_add(&g->parked_workers, 1, __ATOMIC_SEQ_CST);
+  if (work_visible(w)) {
+    __atomic_fetch_sub(&g->parked_workers, 1, __ATOMIC_SEQ_CST);
+    return 1;
+  }
+
+#ifdef COLLECT_STEAL_STATS
+  w->l->parks++;
+#endif
+  cilkos_futex_wait(&g->park_seq, seq, g->park_timeout_us);
+  __atomic_fetch_sub(&g->parked_workers, 1, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&g->park_waking, 0, __ATOMIC_SEQ_CST);
+
+  if (__atomic_load_n(&g->park_seq, __ATOMIC_SEQ_CST) == seq)
+    return 0;
+#ifdef COLLECT_STEAL_STATS
+  w->l->park_wakeups++;
+#endif
+  return 1;
+}
+
+void parking_wake_slow(global_state_t *g, int n)
+{
+  int expected = 0;
+  if (!__atomic_compare_exchange_n(&g->park_waking, &expected, 1, 0,
+                                   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    return; // somebody is already waking a worker up
+  __atomic_fetch_add(&g->park_seq, 1, __ATOMIC_SEQ_CST);
+  cilkos_futex_wake(&g->park_seq, n);
+}
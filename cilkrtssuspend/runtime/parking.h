@@ -0,0 +1,49 @@
+#ifndef INCLUDED_PARKING_DOT_H
+#define INCLUDED_PARKING_DOT_H
+
+#include "rts-common.h"
+#include "global_state.h"
+
+__CILKRTS_BEGIN_EXTERN_C
+
+// Idle system workers park on a futex instead of spinning.
+//
+// A worker parks once it has failed to steal g->park_spins times in a
+// row. It sleeps on g->park_seq until someone calls parking_wake, or
+// for at most g->park_timeout_us, after which it makes one more steal
+// attempt and parks again. The timeout bounds how long work can go
+// unnoticed when nobody wakes us; in particular, spawns that the
+// compiler inlines do not call into the runtime.
+//
+// Work is published with a seq_cst atomic (or followed by a seq_cst
+// fence) before parking_wake reads parked_workers, and parkers count
+// themselves in before their last look for work, so a wake-up is only
+// missed for work that parking_park can't see anyway. That includes
+// stealable frames on other workers' suspended deques: the last look
+// only covers our own pool, since other pools can be resized under
+// us, so such work waits for the timeout unless somebody wakes us.
+//
+// Only one wake-up is in flight at a time. parking_wake does nothing
+// while g->park_waking is set, and the worker that wakes up clears it,
+// so a spawn loop with everyone else asleep pays for one futex call per
+// worker woken, not one per spawn. Woken workers that find work wake
+// the next one themselves (see random_steal).
+
+// Returns 1 if we were woken up (or never slept) because there may be
+// work, and 0 if we slept until the timeout.
+int parking_park(__cilkrts_worker *w);
+
+void parking_wake_slow(global_state_t *g, int n);
+
+// Wakes up to n parked workers. Cheap when nobody is parked, or when a
+// wake-up is already on its way.
+static inline void parking_wake(global_state_t *g, int n)
+{
+	if (__builtin_expect(__atomic_load_n(&g->parked_workers, __ATOMIC_SEQ_CST) > 0, 0)
+	    && !__atomic_load_n(&g->park_waking, __ATOMIC_RELAXED))
+		parking_wake_slow(g, n);
+}
+
+__CILKRTS_END_EXTERN_C
+
+#endif
@@ -0,0 +1,298 @@
+/* pinning.c                  -*-C-*-
+ *
+ *************************************************************************
+ *
+ *  @copyright
+ *  Copyright (C) 2013, Intel Corporation
+ *  All rights reserved.
+ *  
+ *  @copyright
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  
+ *    * Redistributions of source code must retain the above copyright
+ *      notice, this list of conditions and the following disclaimer.
+ *    * Redistributions in binary form must reproduce the above copyright
+ *      notice, this list of conditions and the following disclaimer in
+ *      the documentation and/or other materials provided with the
+ *      distribution.
+ *    * Neither the name of Intel Corporation nor the names of its
+ *      contributors may be used to endorse or promote products derived
+ *      from this software without specific prior written permission.
+ *  
+ *  @copyright
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ *  INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ *  BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ *  OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ *  AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ *  LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY
+ *  WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ *
+ *  Patents Pending, Intel Corporation.
+ **************************************************************************/
+
+/**
+ * Support for pinning of workers to threads.
+ *
+ * This is the part of the pinning support that the runtime uses:
+ * parsing CILK_PINNING, reading the package and core of every
+ * processor from /proc/cpuinfo, and ordering the processors for the
+ * chosen policy.  worker_topology.c builds its socket and core peer
+ * lists from the resulting map.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "bug.h"
+#include "cilk_malloc.h"
+#include "os.h"
+#include "pinning.h"
+
+/// The string to prepend in front of all pinning-related messages.
+static const char* CILK_PIN_MSG_STRING = "CILK_PINNING";
+
+// Determines whether a < b according to a lexicographic order.
+// a[0] is the most-significant term, a[3] is the least-significant.
+inline bool compare_int4(int a[4], int b[4])
+{
+    return std::lexicographical_compare(a, a+4, b, b+4);
+}
+
+/**
+ * Compare lexicographically, with ordering being:
+ *    (id[PACKAGE], id[CORE], id[HW_THREAD])
+ *
+ * This ordering puts the hardware threads of each core next to each
+ * other.
+ */ 
+inline bool compare_proc_id_compact_hw_thread(const proc_id_t& left,
+                                              const proc_id_t& right)
+{
+    int L[4] = { left.id[PACKAGE], left.id[CORE], left.id[HW_THREAD], left.os_id };
+    int R[4] = { right.id[PACKAGE], right.id[CORE], right.id[HW_THREAD], right.os_id };
+    return compare_int4(L, R);
+}
+
+/**
+ * Compare lexicographically, with ordering being:
+ *   (id[HW_THREAD], id[PACKAGE], id[CORE])
+ *
+ * This ordering tries to put consecutive workers onto adjacent cores,
+ * but will try to spread hardware threads as far away from each other
+ * as possible.
+ */
+inline bool compare_proc_id_compact(const proc_id_t& left,
+                                    const proc_id_t& right)
+{
+    int L[4] = { left.id[HW_THREAD], left.id[PACKAGE], left.id[CORE], left.os_id };
+    int R[4] = { right.id[HW_THREAD], right.id[PACKAGE], right.id[CORE], right.os_id };
+    return compare_int4(L, R);
+}
+
+/**
+ * Compare lexicographically, with ordering being:
+ *   (id[HW_THREAD], id[CORE], id[PACKAGE])
+ *
+ * This ordering tries to put consecutive workers further away from
+ * each other.
+ */
+inline bool compare_proc_id_scatter(const proc_id_t& left,
+                                    const proc_id_t& right)
+{
+    int L[4] = { left.id[HW_THREAD], left.id[CORE], left.id[PACKAGE], left.os_id };
+    int R[4] = { right.id[HW_THREAD], right.id[CORE], right.id[PACKAGE], right.os_id };
+    return compare_int4(L, R);
+}
+
+extern "C" {
+
+void pinning_parse_options(pin_options_t* pin_options)
+{
+    char envstr[48];
+    size_t len = cilkos_getenv(envstr, sizeof(envstr), CILK_PIN_MSG_STRING);
+
+    pin_options->policy = PIN_NONE;
+    pin_options->verbose = 0;
+    pin_options->sysinfo = "/proc/cpuinfo";
+    pin_options->expected_num_procs = __cilkrts_hardware_cpu_count();
+
+    if (len == 0)
+        return;
+
+    // A comma-separated list of "scatter", "compact", "none" and
+    // "verbose".  The last policy named wins.
+    char* save_ptr;
+    for (char* token = strtok_r(envstr, ",", &save_ptr);
+         token != NULL;
+         token = strtok_r(NULL, ",", &save_ptr)) {
+        if (0 == strcmp(token, "scatter"))
+            pin_options->policy = PIN_SCATTER;
+        else if (0 == strcmp(token, "compact"))
+            pin_options->policy = PIN_COMPACT;
+        else if (0 == strcmp(token, "none"))
+            pin_options->policy = PIN_NONE;
+        else if (0 == strcmp(token, "verbose"))
+            pin_options->verbose = 1;
+    }
+
+    if (pin_options->verbose) {
+        cilkos_message(CILK_PIN_MSG_STRING, "policy = %s\n",
+                       pin_options->policy == PIN_SCATTER ? "scatter" :
+                       pin_options->policy == PIN_COMPACT ? "compact" : "none");
+    }
+}
+
+/**
+ * @brief Parses an input /proc/cpuinfo file, creating an array of
+ * proc_id_t objects for each processor.
+ *
+ * id[HW_THREAD] is filled in with the apicid, which is a global id;
+ * pinning_relabel_hw_threads() makes it relative to the core.
+ *
+ * @return An array of proc_id_t objects, of length expected_num_procs,
+ *         or NULL if the file did not describe exactly that many
+ *         processors.
+ */
+static proc_id_t* pinning_parse_proc_cpuinfo_file(const char* file_path,
+                                                  int expected_num_procs,
+                                                  int verbosity)
+{
+    FILE* f = fopen(file_path, "r");
+    if (NULL == f)
+        return NULL;
+
+    char buf[1024];
+    int procs_found = 0;
+    proc_id_t* cpu_array =
+        (proc_id_t*)__cilkrts_malloc(sizeof(proc_id_t) * expected_num_procs);
+    proc_id_t current = {-1, {-1, -1, -1}};
+
+    // Each processor is a block of "key : value" lines ended by a
+    // blank line.
+    while (fgets(buf, sizeof(buf), f)) {
+        int tmp;
+        if (sscanf(buf, "processor\t: %d", &tmp) == 1) {
+            current.os_id = tmp;
+        } else if (sscanf(buf, "physical id\t: %d", &tmp) == 1) {
+            current.id[PACKAGE] = tmp;
+        } else if (sscanf(buf, "core id\t: %d", &tmp) == 1) {
+            current.id[CORE] = tmp;
+        } else if (sscanf(buf, "apicid\t: %d", &tmp) == 1) {
+            current.id[HW_THREAD] = tmp;
+        } else if (buf[0] == '\n' && current.os_id >= 0) {
+            if (current.id[PACKAGE] >= 0 && current.id[PACKAGE] < CILK_MAX_PROC_ID &&
+                current.id[CORE] >= 0 && current.id[CORE] < CILK_MAX_PROC_ID &&
+                current.id[HW_THREAD] >= 0 && current.id[HW_THREAD] < CILK_MAX_PROC_ID &&
+                procs_found < expected_num_procs) {
+                if (verbosity >= 2) {
+                    cilkos_message(CILK_PIN_MSG_STRING,
+                                   "Found processor %d: package=%d, core=%d, apicid=%d\n",
+                                   current.os_id, current.id[PACKAGE],
+                                   current.id[CORE], current.id[HW_THREAD]);
+                }
+                cpu_array[procs_found++] = current;
+            }
+            current.os_id = -1;
+            current.id[PACKAGE] = current.id[CORE] = current.id[HW_THREAD] = -1;
+        }
+    }
+    fclose(f);
+
+    if (procs_found != expected_num_procs) {
+        cilkos_message(CILK_PIN_MSG_STRING,
+                       "WARNING: could not parse %s.. found %d processors, expected %d\n",
+                       file_path, procs_found, expected_num_procs);
+        __cilkrts_free(cpu_array);
+        return NULL;
+    }
+    return cpu_array;
+}
+
+/**
+ * Relabels the id[HW_THREAD] of every processor as 0, 1, 2, ...
+ * within its core, and finds the largest package id.
+ */
+static void pinning_relabel_hw_threads(system_cpu_map *sysmap)
+{
+    proc_id_t *p = sysmap->worker_to_proc;
+    int n = sysmap->hardware_thread_count;
+
+    std::sort(p, p + n, compare_proc_id_compact_hw_thread);
+
+    sysmap->max_cpu = p[0];
+    for (int i = 0; i < n; ++i) {
+        if (i > 0 && p[i].id[PACKAGE] == p[i-1].id[PACKAGE]
+            && p[i].id[CORE] == p[i-1].id[CORE])
+            p[i].id[HW_THREAD] = p[i-1].id[HW_THREAD] + 1;
+        else
+            p[i].id[HW_THREAD] = 0;
+
+        sysmap->max_cpu.os_id = std::max(sysmap->max_cpu.os_id, p[i].os_id);
+        for (int j = 0; j < PROC_ID_NUM_LEVELS; ++j)
+            sysmap->max_cpu.id[j] = std::max(sysmap->max_cpu.id[j], p[i].id[j]);
+    }
+}
+
+system_cpu_map* pinning_create_system_map(pin_options_t* pin_options,
+                                          int verbosity)
+{
+    if (pin_options->policy <= PIN_NONE || pin_options->policy >= PIN_MAX_TYPE
+        || pin_options->expected_num_procs <= 0)
+        return NULL;
+
+    proc_id_t* procs =
+        pinning_parse_proc_cpuinfo_file(pin_options->sysinfo,
+                                        pin_options->expected_num_procs,
+                                        verbosity);
+    if (NULL == procs)
+        return NULL;
+
+    system_cpu_map* gss = (system_cpu_map*) __cilkrts_malloc(sizeof(system_cpu_map));
+    gss->worker_to_proc = procs;
+    gss->hardware_thread_count = pin_options->expected_num_procs;
+    pinning_relabel_hw_threads(gss);
+
+    std::sort(procs, procs + gss->hardware_thread_count,
+              pin_options->policy == PIN_SCATTER ?
+              compare_proc_id_scatter : compare_proc_id_compact);
+
+    if (verbosity >= 1) {
+        for (int i = 0; i < gss->hardware_thread_count; ++i) {
+            cilkos_message(CILK_PIN_MSG_STRING,
+                           "%d: os_id=%d, HW_THREAD=%d, CORE=%d, PACKAGE=%d\n",
+                           i, procs[i].os_id, procs[i].id[HW_THREAD],
+                           procs[i].id[CORE], procs[i].id[PACKAGE]);
+        }
+    }
+    return gss;
+}
+
+void pinning_destroy_system_map(system_cpu_map* sysmap)
+{
+    if (sysmap) {
+        CILK_ASSERT(sysmap->worker_to_proc);
+        __cilkrts_free(sysmap->worker_to_proc);
+        __cilkrts_free(sysmap);
+    }
+}
+
+void pinning_report_thread_pin(const char *desc, int32_t wkr_id, int os_id)
+{
+    cilkos_message(CILK_PIN_MSG_STRING,
+                   "Pin worker number %d to %d (%s)\n",
+                   wkr_id,
+                   os_id,
+                   desc);
+}
+
+}; // End extern "C"
@@ -65,6 +65,8 @@
 #include "cilk_malloc.h"
 #include "pedigrees.h"
 #include "record-replay.h"
+#include "worker_topology.h"
+#include "parking.h"
 
 #include <limits.h>
 #include <string.h> /* memcpy */
@@ -706,20 +708,18 @@ void fiber_proc_to_resume_user_code_for_random_steal(cilk_fiber *fiber)
 #endif
 }
 
-static void jump_to_suspended_fiber(__cilkrts_worker *w,
-                                    __cilkrts_worker *victim, deque *d)
+static void jump_to_suspended_fiber(__cilkrts_worker *w, deque *d)
 {
 
-    /* fprintf(stderr, "(w: %i) actually resuming a suspended fiber/deque (%p) from %i\n", */
-    /*         w->self, d, victim->self); */
-    CILK_ASSERT(d->worker == victim);
+    /* fprintf(stderr, "(w: %i) actually resuming a suspended fiber/deque (%p)\n", */
+    /*         w->self, d); */
+    // d was already taken off a resumable queue by deque_queue_pop
+    CILK_ASSERT(d->worker == NULL);
     CILK_ASSERT(d->fiber);
     CILK_ASSERT(d->resumable == 1);
     CILK_ASSERT(d->call_stack);
 
     cilk_fiber *fiber = d->fiber;
-    deque_mug(w, d);
-    __cilkrts_mutex_unlock(w, &victim->l->lock);
 
     // The deque has definitely been suspended, but its owner might
     // not yet have switched fibers!
@@ -739,7 +739,7 @@ static void jump_to_suspended_fiber(__cilkrts_worker *w,
     } END_WITH_WORKER_LOCK(w);
 
     // No one can see this now
-    deque_destroy(old_deque);
+    deque_destroy(w, old_deque);
 
     CILK_ASSERT(*w->l->frame_ff);
 
@@ -755,30 +755,34 @@ static void jump_to_suspended_fiber(__cilkrts_worker *w,
     //CILK_ASSERT(w->l->next_frame_ff == NULL);
 }
 
-static deque* choose_deque(__cilkrts_worker *w, __cilkrts_worker *victim)
+static deque* choose_deque(__cilkrts_worker *w, __cilkrts_worker *victim,
+                           int help)
 {
     CILK_ASSERT(victim->l->lock.owner == w);
     int index;
     deque_pool* pool;
 
-    // Current policy: if there is a resumable deque, you must take it
-    if (victim->l->resumable_deques.size > 0) {
-        pool = &victim->l->resumable_deques;
-
-        // Really we'd like to take the first element, but with the
-        // current implementation that would change the order (swap
-        // the last element)
-        /// @todo{ Implement resumable deques as a deque itself, with stealing from the top}
-        index = victim->l->resumable_deques.size;
-        //index = 1;
+    // Resumable deques are taken in random_steal, before the victim's
+    // lock is acquired, so here we only pick among suspended deques.
+    pool = &victim->l->suspended_deques;
+    if (help) {
+        // The producer runs on the victim's active deque, unless it has
+        // since blocked itself
+        index = 0;
+    } else if (w == victim && pool->size > 0
+        && w->g->suspend_policy != SUSPEND_PROACTIVE) {
+        // Work on the last deque in our pool that has something left to
+        // steal. That is usually the one we suspended most recently,
+        // like popping the bottom of our own deque, but removals swap
+        // entries, so not always.
+        index = pool->size;
+        while (index > 1 && !(pool->array[index-1]->frame_ff
+                              && can_steal_from(w, pool->array[index-1])))
+            index--;
+    } else if (w == victim && pool->size > 0) {// don't choose 0 (active_deque)
+        index = (myrand(w) % (pool->size)) + 1;
     } else {
-        pool = &victim->l->suspended_deques;
-        if (w == victim && pool->size > 0) {// don't choose 0 (active_deque)
-            index = (myrand(w) % (pool->size)) + 1;
-        } else {
-            index = myrand(w) % (pool->size + 1);
-        }
-        
+        index = myrand(w) % (pool->size + 1);
     }
     
     if (w == victim && pool->size == 0) { // someone mugged us
@@ -794,12 +798,74 @@ static deque* choose_deque(__cilkrts_worker *w, __cilkrts_worker *victim)
 }
 
 
+// How many deques a thief should take from a victim that has
+// available of them, on top of the one it is about to run.
+static int steal_batch_extra(global_state_t *g, int available)
+{
+    if (g->steal_batch == 0) // steal half
+        return available / 2;
+    return (g->steal_batch - 1 < available) ? g->steal_batch - 1 : available;
+}
+
+// Whether we have work of our own: a deque of ours that is ready to
+// resume, or frames left to steal on one we suspended. Under the
+// parsimonious and hybrid policies, a worker takes that before anyone
+// else's (see keep_suspended_deque).
+static int own_deques_have_work(__cilkrts_worker *w)
+{
+    if (w->l->resumable_deques.size > 0)
+        return 1;
+    if (w->l->suspended_deques.size == 0)
+        return 0;
+
+    // Whoever holds our lock may be stealing from us; try elsewhere.
+    if (!__cilkrts_mutex_trylock(w, &w->l->lock))
+        return 0;
+    int found = 0;
+    deque_pool *p = &w->l->suspended_deques;
+    for (int i = p->size - 1; i >= 0 && !found; i--)
+        found = p->array[i]->frame_ff && can_steal_from(w, p->array[i]);
+    __cilkrts_mutex_unlock(w, &w->l->lock);
+    return found;
+}
+
+// Takes the oldest of victim's resumable deques, without its lock, and
+// some more to keep for other thieves to find on us (see steal_batch).
+// Returns NULL if there are none.
+static deque* take_resumable_deque(__cilkrts_worker *w, __cilkrts_worker *victim)
+{
+    deque *d = deque_queue_pop(w, &victim->l->resumable_deques);
+    if (!d)
+        return NULL;
+    #ifdef COLLECT_STEAL_STATS
+        w->l->ks_stats.random_steal_deque_muggings++;
+    #endif
+    // If there is more where that came from, get someone else up.
+    if (victim->l->resumable_deques.size > 0)
+        parking_wake(w->g, 1);
+
+    // Take some more for other thieves to find on us.
+    if (victim != w && w->l->type == WORKER_SYSTEM) {
+        int n = steal_batch_extra(w->g, victim->l->resumable_deques.size);
+        deque *extra;
+        while (n-- > 0
+               && (extra = deque_queue_pop(w, &victim->l->resumable_deques))) {
+            deque_queue_push(w, &w->l->resumable_deques, extra);
+            #ifdef COLLECT_STEAL_STATS
+                w->l->ks_stats.batch_stolen_deques++;
+            #endif
+        }
+    }
+    return d;
+}
+
 static void random_steal(__cilkrts_worker *w)
 {
     __cilkrts_worker *victim = NULL;
     cilk_fiber *fiber = NULL;
     int n;
     int success = 0;
+    int help = 0;
     int32_t victim_id;
 
     
@@ -831,18 +897,42 @@ static void random_steal(__cilkrts_worker *w)
         n = 0;
         CILK_ASSERT(w->l->suspended_deques.size > 0
                     || w->l->resumable_deques.size > 0);
+    } else if (w->l->help_target) {
+        // We just blocked in get(); steal from whoever is producing
+        // the value, as in leapfrogging, to hurry it along.
+        n = w->l->help_target->self;
+        w->l->help_target = NULL;
+        help = 1;
+        #ifdef COLLECT_STEAL_STATS
+            w->l->ks_stats.help_steal_attempts++;
+        #endif
     } else {
 
         // We don't hold the lock here, so we may read a stale
         // value. But that's okay -- we just won't steal from
         // ourselves. In the worst case we just loop around again.
-        if ((w->l->suspended_deques.size + w->l->resumable_deques.size) == 0) {
-            n = myrand(w) % (w->g->total_workers - 1);
-            /* pick random *other* victim */
-            if (n >= w->self)
-                ++n;
+        //
+        // Pinned workers try a victim on their own core or socket
+        // first; otherwise (or if that doesn't pan out) anyone will do.
+        int own_work = w->g->suspend_policy != SUSPEND_PROACTIVE
+            && own_deques_have_work(w);
+        if (own_work) {
+            // Keep to our own deques until there is nothing left on
+            // them (see keep_suspended_deque).
+            n = w->self;
         } else {
-            n = myrand(w) % w->g->total_workers;
+            n = worker_topology_pick_victim(w);
+        }
+        if (n < 0) {
+            if (w->g->suspend_policy != SUSPEND_PROACTIVE
+                || (w->l->suspended_deques.size + w->l->resumable_deques.size) == 0) {
+                n = myrand(w) % (w->g->total_workers - 1);
+                /* pick random *other* victim */
+                if (n >= w->self)
+                    ++n;
+            } else {
+                n = myrand(w) % w->g->total_workers;
+            }
         }
     }
 
@@ -856,18 +946,18 @@ static void random_steal(__cilkrts_worker *w)
 
     victim = w->g->workers[n];
 
+    // Current policy: if there is a resumable deque, you must take
+    // it. When helping a producer, though, the frames on its active
+    // deque are what will get our future put, so try those first and
+    // only fall back to its resumable deques (see below).
+    deque *d;
+    if (!help && (d = take_resumable_deque(w, victim)))
+        return jump_to_suspended_fiber(w, d);
+
     // The suspended deques could change, so we need the lock just to select a deque
     if (!__cilkrts_mutex_trylock(w, &victim->l->lock)) goto done;
-    deque *d = choose_deque(w, victim);
+    d = choose_deque(w, victim, help);
     if (!d) goto done;
-    
-    // We own victim lock, so it can't change its active deque
-    if (d != victim->l->active_deque && d->resumable) {
-            #ifdef COLLECT_STEAL_STATS
-                w->l->ks_stats.random_steal_deque_muggings++;
-            #endif
-        return jump_to_suspended_fiber(w, victim, d); // will release lock
-    }
 
     if (w->l->active_deque == NULL) // the only thing we could have done is resume
         goto done;
@@ -944,6 +1034,22 @@ static void random_steal(__cilkrts_worker *w)
                     detach_for_steal(w, victim, d, fiber);
                     victim_id = victim->self;
 
+                    // Work tends to come in bunches; if anyone is
+                    // asleep, have them come and look too.
+                    parking_wake(w->g, 1);
+
+                    // While we have the victim locked, take some of
+                    // its other suspended deques as well.
+                    if (w->l->type == WORKER_SYSTEM) {
+                        int moved = deque_pool_steal_batch(w, victim, d,
+                                                           w->g->steal_batch);
+                        #ifdef COLLECT_STEAL_STATS
+                            w->l->ks_stats.batch_stolen_deques += moved;
+                        #else
+                            (void) moved;
+                        #endif
+                    }
+
 #if REDPAR_DEBUG >= 1
                     fprintf(stderr, "Wkr %d stole from victim %d, fiber = %p\n",
                             w->self, victim->self, fiber);
@@ -981,16 +1087,24 @@ done:
     if (0 == success) {
         NOTE_INTERVAL(w, INTERVAL_STEAL_FAIL);
         // failed to steal work.  Return the fiber to the pool.
-        if (NULL == fiber) return;
-        START_INTERVAL(w, INTERVAL_FIBER_DEALLOCATE) {
-            int ref_count = cilk_fiber_remove_reference(fiber, &w->l->fiber_pool);
-            // Fibers we use when trying to steal should not be active,
-            // and thus should not have any other references.
-            CILK_ASSERT(0 == ref_count);
-        } STOP_INTERVAL(w, INTERVAL_FIBER_DEALLOCATE);
+        if (fiber) {
+            START_INTERVAL(w, INTERVAL_FIBER_DEALLOCATE) {
+                int ref_count = cilk_fiber_remove_reference(fiber, &w->l->fiber_pool);
+                // Fibers we use when trying to steal should not be active,
+                // and thus should not have any other references.
+                CILK_ASSERT(0 == ref_count);
+            } STOP_INTERVAL(w, INTERVAL_FIBER_DEALLOCATE);
+        }
+
+        // Nothing to steal near the producer; its resumable deques
+        // are the next best thing.
+        if (help && (d = take_resumable_deque(w, victim)))
+            return jump_to_suspended_fiber(w, d);
     } else {
         #ifdef COLLECT_STEAL_STATS
             w->l->ks_stats.successful_random_steals++;
+            if (help)
+                w->l->ks_stats.help_steals++;
         #endif
         if (w->l->next_frame_ff->call_stack->flags & CILK_FRAME_FUTURE_PARENT) {
             START_INTERVAL(w, INTERVAL_FIBER_DEALLOCATE) {
@@ -1786,7 +1900,17 @@ static full_frame* check_for_work(__cilkrts_worker *w)
         if (NULL == ff) {
             // Punish the worker for failing to steal.
             // No quantum for you!
-            if (w->l->steal_failure_count > 30000) {
+            if (WORKER_SYSTEM == w->l->type && w->g->park_spins > 0
+                && w->l->steal_failure_count >= (unsigned) w->g->park_spins) {
+                // Done spinning: sleep until there is work. If we were
+                // woken up, spin again for a while before the next nap;
+                // if we timed out, one more steal attempt is enough.
+                if (parking_park(w))
+                    w->l->steal_failure_count = 0;
+                else
+                    w->l->steal_failure_count++;
+                return ff;
+            } else if (w->l->steal_failure_count > 30000) {
                 // Punish more if the worker has been doing unsuccessful steals
                 // for a long time. After return from the idle state, it will
                 // be given a grace period to react quickly.
@@ -2737,11 +2861,21 @@ void __cilkrts_c_return_from_initial(__cilkrts_worker *w)
     kyles_steal_stats output_stats;
     uint64_t sync_suspends = 0;
     uint64_t susp_empty = 0;
+    uint64_t fiber_cache_hits = 0;
+    uint64_t fiber_cache_steals = 0;
+    uint64_t fiber_cache_misses = 0;
+    uint64_t parks = 0;
+    uint64_t park_wakeups = 0;
     memset(&output_stats, 0, sizeof(output_stats));
     for (int i = 0; i < w->g->total_workers; i++) {
         w = w->g->workers[i];
         susp_empty += w->l->num_susp_empty;
         sync_suspends += w->l->sync_suspend;
+        fiber_cache_hits += w->l->future_fibers.hits;
+        fiber_cache_steals += w->l->future_fibers.steals;
+        fiber_cache_misses += w->l->future_fibers.misses;
+        parks += w->l->parks;
+        park_wakeups += w->l->park_wakeups;
         kyles_steal_stats ks = w->l->ks_stats;
         output_stats.random_steal_attempts += ks.random_steal_attempts;
         output_stats.successful_random_steals += ks.successful_random_steals;
@@ -2751,6 +2885,22 @@ void __cilkrts_c_return_from_initial(__cilkrts_worker *w)
         output_stats.successful_steal_on_suspend += ks.successful_steal_on_suspend;
         output_stats.deques_mugged_on_suspend += ks.deques_mugged_on_suspend;
         output_stats.deques_resumed += ks.deques_resumed;
+        output_stats.core_steal_attempts += ks.core_steal_attempts;
+        output_stats.socket_steal_attempts += ks.socket_steal_attempts;
+        output_stats.batch_stolen_deques += ks.batch_stolen_deques;
+        output_stats.ltq_allocs += ks.ltq_allocs;
+        output_stats.ltq_shrinks += ks.ltq_shrinks;
+        output_stats.ltq_kept_full += ks.ltq_kept_full;
+        output_stats.suspends_kept_local += ks.suspends_kept_local;
+        output_stats.get_waits += ks.get_waits;
+        output_stats.get_waits_suspended += ks.get_waits_suspended;
+        output_stats.suspends_over_cap += ks.suspends_over_cap;
+        output_stats.help_steal_attempts += ks.help_steal_attempts;
+        output_stats.help_steals += ks.help_steals;
+        output_stats.get_spins_ready += ks.get_spins_ready;
+        output_stats.get_spins_expired += ks.get_spins_expired;
+        output_stats.urgent_resumes += ks.urgent_resumes;
+        output_stats.priority_overrides += ks.priority_overrides;
         /*kyles_steal_stats ks = w->l->ks_stats;
         printf("worker %d steal stats:\n"
                "    --raw counts--\n"
@@ -2808,6 +2958,28 @@ void __cilkrts_c_return_from_initial(__cilkrts_worker *w)
 
         fflush(stdout);
         printf("num susp empt: %llu\n", susp_empty);
+        printf("future fiber cache: %llu hits, %llu stolen, %llu misses\n",
+               fiber_cache_hits, fiber_cache_steals, fiber_cache_misses);
+        printf("steal victims: %llu same core, %llu same socket, %llu anywhere\n",
+               output_stats.core_steal_attempts, output_stats.socket_steal_attempts,
+               output_stats.random_steal_attempts - output_stats.core_steal_attempts
+               - output_stats.socket_steal_attempts);
+        printf("deques taken in batches: %llu\n", output_stats.batch_stolen_deques);
+        printf("parked: %llu times, %llu woken up, %llu timed out\n",
+               parks, park_wakeups, parks - park_wakeups);
+        printf("LTQs: %llu allocated (%zu bytes each), %llu given back on suspend, %llu kept\n",
+               output_stats.ltq_allocs, w->g->ltqsize * sizeof(void*),
+               output_stats.ltq_shrinks, output_stats.ltq_kept_full);
+        printf("suspended deques kept local: %llu\n", output_stats.suspends_kept_local);
+        printf("get() past max suspended: %llu waited (%llu then suspended), %llu suspended anyway\n",
+               output_stats.get_waits, output_stats.get_waits_suspended,
+               output_stats.suspends_over_cap);
+        printf("steals from a blocked get()'s producer: %llu tried, %llu got work\n",
+               output_stats.help_steal_attempts, output_stats.help_steals);
+        printf("get_or_spin() spins: %llu saw the put, %llu ran out\n",
+               output_stats.get_spins_ready, output_stats.get_spins_expired);
+        printf("priority deques resumed: %llu, %llu others let through by the burst limit\n",
+               output_stats.urgent_resumes, output_stats.priority_overrides);
 
     w = bkup_w;
     #endif
@@ -3009,6 +3181,7 @@ __cilkrts_worker *make_worker(global_state_t *g,
         memset(&w->l->ks_stats, 0, sizeof(w->l->ks_stats));
         w->l->num_susp_empty++;
         w->l->sync_suspend = 0;
+        w->l->parks = w->l->park_wakeups = 0;
     #endif
 
     __cilkrts_frame_malloc_per_worker_init(w);
@@ -3027,10 +3200,18 @@ __cilkrts_worker *make_worker(global_state_t *g,
     w->l->next_frame_ff = 0;
     w->l->last_full_frame = NULL;
 
-    w->l->active_deque = __cilkrts_malloc(sizeof(deque));
-    deque_init(w->l->active_deque, w->g->ltqsize);
+    w->l->deque_freelist = NULL;
+    w->l->deque_freelist_size = 0;
+    w->l->ltq_cache = w->l->fiber_ltq_cache = NULL;
+    w->l->ltq_cache_size = w->l->fiber_ltq_cache_size = 0;
+    w->l->socket = -1; // set by worker_topology_init
+    w->l->steal_peers = NULL;
+    w->l->num_core_peers = w->l->num_socket_peers = 0;
+    w->l->help_target = NULL;
+    w->l->suspend_reserved = 0;
+    w->l->active_deque = deque_alloc(w);
     deque_pool_init(&w->l->suspended_deques, w->g->ltqsize);
-    deque_pool_init(&w->l->resumable_deques, w->g->ltqsize);
+    deque_queue_init(&w->l->resumable_deques);
     deque_switch(w, w->l->active_deque);
         
     cilk_fiber_pool_init(&w->l->fiber_pool,
@@ -3040,11 +3221,8 @@ __cilkrts_worker *make_worker(global_state_t *g,
                          0,   // alloc_max is 0.  We don't allocate from the heap directly without checking the parent pool.
                          0);
 
-    w->l->future_fiber_pool_idx = -1;
-    for (int i = 0; i < MAX_FUTURE_FIBERS_IN_POOL; i++) {
-        w->l->future_fiber_pool[i] = cilk_fiber_allocate(&w->l->fiber_pool);
-    }
-    w->l->future_fiber_pool_idx = MAX_FUTURE_FIBERS_IN_POOL-1;
+    // Filled lazily, as futures are created
+    future_fiber_cache_init(&w->l->future_fibers, g->future_fiber_cache_size);
 
 #if FIBER_DEBUG >= 2
     fprintf(stderr, "ThreadId=%p: Making w=%d (%p), pool = %p\n",
@@ -3125,10 +3303,7 @@ void destroy_worker(__cilkrts_worker *w)
     CILK_ASSERT(NULL == w->l->stats);
 #endif
     
-    for (int i = 0; i <= w->l->future_fiber_pool_idx; i++) {
-        cilk_fiber_remove_reference(w->l->future_fiber_pool[i], NULL /*&w->l->fiber_pool*/);
-    }
-    w->l->future_fiber_pool_idx = -1;
+    future_fiber_cache_destroy(w, &w->l->future_fibers);
     /* Free any cached fibers. */
     cilk_fiber_pool_destroy(&w->l->fiber_pool);
 
@@ -3139,10 +3314,10 @@ void destroy_worker(__cilkrts_worker *w)
         signal_node_destroy(w->l->signal_node);
     }
 
-    __cilkrts_free(*w->l->current_ltq);
     deque_pool_free(&w->l->suspended_deques);
-    deque_pool_free(&w->l->resumable_deques);
-    __cilkrts_free(w->l->active_deque);
+    deque_queue_free(&w->l->resumable_deques);
+    deque_free(w, w->l->active_deque);
+    deque_worker_cleanup(w);
 
     __cilkrts_mutex_destroy(0, &w->l->lock);
     __cilkrts_mutex_destroy(0, &w->l->steal_lock);
@@ -3189,6 +3364,12 @@ void __cilkrts_deinit_internal(global_state_t *g)
     // Destroy any system dependent global state
     __cilkrts_destroy_global_sysdep(g);
 
+    worker_topology_cleanup(g);
+    if (g->pin_map) {
+        pinning_destroy_system_map(g->pin_map);
+        g->pin_map = NULL;
+    }
+
     for (i = 0; i < g->total_workers; ++i)
         destroy_worker(g->workers[i]);
 
@@ -3199,6 +3380,7 @@ void __cilkrts_deinit_internal(global_state_t *g)
 
     cilk_fiber_pool_destroy(&g->fiber_pool);
     __cilkrts_frame_malloc_global_cleanup(g);
+    deque_global_cleanup(g);
 
     cilkg_deinit_global_state();
 }
@@ -3379,6 +3561,14 @@ void __cilkrts_init_internal(int start)
                 __cilkrts_establish_c_stack();     
             init_workers(g);
 
+            // Read in system cpu map, and work out which workers are
+            // close to each other.
+            if (g->pin_options.policy != PIN_NONE) {
+                g->pin_map = pinning_create_system_map(&g->pin_options,
+                                                       g->pin_options.verbose);
+            }
+            worker_topology_init(g);
+
             // Initialize per-work record/replay logging
             replay_init_workers(g);
 
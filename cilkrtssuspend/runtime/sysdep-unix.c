@@ -50,6 +50,12 @@
  **************************************************************************
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    // define _GNU_SOURCE before *any* #include, for the CPU_SET macros
+    // and pthread_setaffinity_np.
+#   define _GNU_SOURCE
+#endif
+
 #include "sysdep.h"
 #include "os.h"
 #include "bug.h"
@@ -60,6 +66,8 @@
 #include "cilk_malloc.h"
 #include "reducer_impl.h"
 #include "metacall_impl.h"
+#include "pinning.h"
+#include "parking.h"
 
 
 // On x86 processors (but not MIC processors), the compiler generated code to
@@ -84,6 +92,7 @@
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
+#include <limits.h> // INT_MAX
 #include "declare-alloca.h"
 
 #ifdef __linux__
@@ -191,6 +200,7 @@ NON_COMMON void* scheduler_thread_proc_for_system_worker(void *arg)
     CILK_ASSERT(status == 0);*/
     
     __cilkrts_set_tls_worker(w);
+    set_current_worker_affinity_sysdep(w);
 
     START_INTERVAL(w, INTERVAL_IN_SCHEDULER);
     START_INTERVAL(w, INTERVAL_IN_RUNTIME);
@@ -261,6 +271,39 @@ void* __cilkrts_worker_stub(void* arg)
 
 static void write_version_file (global_state_t *, int);
 
+// Pins the worker for the currently executing thread to the
+// hardware thread that g->pin_map assigns it.
+COMMON_SYSDEP
+void set_current_worker_affinity_sysdep(__cilkrts_worker *w)
+{
+#if defined(__linux__) && !defined(ANDROID)
+    int wkr_id = w->self;
+    // Figure out where to pin the current worker to.
+    int os_id = pinning_map_worker_id_to_os_processor(w->g->pin_map,
+                                                      wkr_id,
+                                                      w->g->P);
+
+    if (-1 != os_id) {
+        // Report if verbosity setting is set.
+        if (w->g->pin_options.verbose) {
+            pinning_report_thread_pin(WORKER_USER == w->l->type ?
+                                      "user" : "system",
+                                      wkr_id, os_id);
+        }
+
+        // Actually do the OS call to pin.
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(os_id, &cpuset);
+        int error_code = pthread_setaffinity_np(pthread_self(),
+                                                sizeof(cpu_set_t), &cpuset);
+        if (error_code != 0)
+            cilkos_warning("could not pin worker %d to processor %d: %d\n",
+                           wkr_id, os_id, error_code);
+    }
+#endif // defined(__linux__) && !defined(ANDROID)
+}
+
 /* Create n worker threads from base..top-1
  */
 static void create_threads(global_state_t *g, int base, int top)
@@ -342,6 +385,7 @@ void __cilkrts_stop_workers(global_state_t *g)
 
     // Tell the workers to give up
     g->work_done = 1;
+    parking_wake(g, INT_MAX);
 
     if (g->workers_running == 0)
         return;
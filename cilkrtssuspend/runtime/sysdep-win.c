@@ -752,6 +752,16 @@ void __cilkrts_make_unrunnable_sysdep(__cilkrts_worker *w,
 #define USER_WORKER_FLAG 0xf0000000
 #endif
 
+/*
+ * set_current_worker_affinity_sysdep
+ *
+ * Worker pinning is not implemented on Windows.
+ */
+
+void set_current_worker_affinity_sysdep(__cilkrts_worker *w)
+{
+}
+
 /*
  * __cilkrts_establish_c_stack
  *
@@ -109,6 +109,15 @@ void __cilkrts_destroy_global_sysdep(global_state_t *g);
 COMMON_SYSDEP
 void __cilkrts_establish_c_stack(void);
 
+/**
+ * @brief Pin the currently executing worker to the hardware thread
+ * given by g->pin_map, if workers are being pinned.
+ *
+ * This method is not currently implemented on Windows.
+ */
+COMMON_SYSDEP
+void set_current_worker_affinity_sysdep(__cilkrts_worker *w);
+
 
 /**
  * Save system dependent information in the full_frame and
@@ -0,0 +1,158 @@
+#include "worker_topology.h"
+#include "local_state.h"
+#include "deque_pool.h"
+#include "scheduler.h" // myrand
+#include "cilk_malloc.h"
+#include "bug.h"
+#include "os.h" // cilkos_message
+
+static void* alloc_or_die(size_t size)
+{
+  void *p = __cilkrts_malloc(size);
+  if (!p)
+    __cilkrts_bug("Cilk: could not allocate worker topology\n");
+  return p;
+}
+
+void worker_topology_init(global_state_t *g)
+{
+  int P = g->total_workers;
+  int i, j;
+
+  for (i = 0; i < P; i++) {
+    local_state *l = g->workers[i]->l;
+    l->socket = -1;
+    l->steal_peers = NULL;
+    l->num_core_peers = l->num_socket_peers = 0;
+  }
+
+  g->num_sockets = 0;
+  g->socket_start = NULL;
+  g->socket_workers = NULL;
+
+  if (!g->pin_map)
+    return;
+
+  if (g->steal_core_pct + g->steal_socket_pct > 100)
+    g->steal_socket_pct = 100 - g->steal_core_pct;
+
+  // Package ids need not be dense, so number the sockets in the order
+  // we first see them.
+  const proc_id_t **proc = (const proc_id_t**) alloc_or_die(P * sizeof(proc_id_t*));
+  int max_package = g->pin_map->max_cpu.id[PACKAGE];
+  int *socket_of_package = (int*) alloc_or_die((max_package + 1) * sizeof(int));
+  for (i = 0; i <= max_package; i++)
+    socket_of_package[i] = -1;
+
+  for (i = 0; i < P; i++) {
+    proc[i] = pinning_map_worker_id_to_proc(g->pin_map, i, g->P);
+    int package = proc[i]->id[PACKAGE];
+    if (socket_of_package[package] < 0)
+      socket_of_package[package] = g->num_sockets++;
+    g->workers[i]->l->socket = socket_of_package[package];
+  }
+
+  // Bucket the workers by socket.
+  g->socket_start = (int*) alloc_or_die((g->num_sockets + 1) * sizeof(int));
+  g->socket_workers = (__cilkrts_worker**) alloc_or_die(P * sizeof(__cilkrts_worker*));
+  int n = 0;
+  for (int s = 0; s < g->num_sockets; s++) {
+    g->socket_start[s] = n;
+    for (i = 0; i < P; i++) {
+      if (g->workers[i]->l->socket == s)
+        g->socket_workers[n++] = g->workers[i];
+    }
+  }
+  g->socket_start[g->num_sockets] = n;
+
+  // Each worker's peers: other workers on its core, then the rest of
+  // its socket.
+  for (i = 0; i < P; i++) {
+    local_state *l = g->workers[i]->l;
+    int s = l->socket;
+    int peers = g->socket_start[s + 1] - g->socket_start[s] - 1;
+    if (peers == 0)
+      continue;
+
+    l->steal_peers = (int*) alloc_or_die(peers * sizeof(int));
+    for (j = 0; j < P; j++) {
+      if (j != i && g->workers[j]->l->socket == s
+          && proc[j]->id[CORE] == proc[i]->id[CORE])
+        l->steal_peers[l->num_core_peers++] = j;
+    }
+    for (j = 0; j < P; j++) {
+      if (j != i && g->workers[j]->l->socket == s
+          && proc[j]->id[CORE] != proc[i]->id[CORE])
+        l->steal_peers[l->num_core_peers + l->num_socket_peers++] = j;
+    }
+  }
+
+  if (g->pin_options.verbose) {
+    for (i = 0; i < P; i++) {
+      local_state *l = g->workers[i]->l;
+      cilkos_message("CILK_PINNING",
+                     "worker %d: socket %d, %d core peers, %d socket peers\n",
+                     i, l->socket, l->num_core_peers, l->num_socket_peers);
+    }
+  }
+
+  __cilkrts_free(socket_of_package);
+  __cilkrts_free(proc);
+}
+
+void worker_topology_cleanup(global_state_t *g)
+{
+  for (int i = 0; i < g->total_workers; i++) {
+    __cilkrts_free(g->workers[i]->l->steal_peers);
+    g->workers[i]->l->steal_peers = NULL;
+  }
+  __cilkrts_free(g->socket_start);
+  __cilkrts_free(g->socket_workers);
+  g->socket_start = NULL;
+  g->socket_workers = NULL;
+  g->num_sockets = 0;
+}
+
+int worker_topology_pick_victim(__cilkrts_worker *w)
+{
+  local_state *l = w->l;
+  if (l->num_core_peers + l->num_socket_peers == 0)
+    return -1;
+
+  // If there is nobody else on our core, the core's share goes to the
+  // socket.
+  int r = myrand(w) % 100;
+  if (r < w->g->steal_core_pct && l->num_core_peers > 0) {
+#ifdef COLLECT_STEAL_STATS
+    l->ks_stats.core_steal_attempts++;
+#endif
+    return l->steal_peers[myrand(w) % l->num_core_peers];
+  }
+  if (r < w->g->steal_core_pct + w->g->steal_socket_pct
+      && l->num_socket_peers > 0) {
+#ifdef COLLECT_STEAL_STATS
+    l->ks_stats.socket_steal_attempts++;
+#endif
+    return l->steal_peers[l->num_core_peers + myrand(w) % l->num_socket_peers];
+  }
+  return -1;
+}
+
+__cilkrts_worker* worker_topology_pick_on_socket(__cilkrts_worker *w,
+                                                 int socket)
+{
+  global_state_t *g = w->g;
+  if (socket < 0 || socket >= g->num_sockets)
+    return NULL;
+
+  __cilkrts_worker **workers = g->socket_workers + g->socket_start[socket];
+  int n = g->socket_start[socket + 1] - g->socket_start[socket];
+
+  __cilkrts_worker *victim = workers[myrand(w) % n];
+  if (n > 1) {
+    __cilkrts_worker *other = workers[myrand(w) % n];
+    if (other->l->resumable_deques.size < victim->l->resumable_deques.size)
+      victim = other;
+  }
+  return victim;
+}
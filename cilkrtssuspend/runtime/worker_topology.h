@@ -0,0 +1,31 @@
+#ifndef INCLUDED_WORKER_TOPOLOGY_DOT_H
+#define INCLUDED_WORKER_TOPOLOGY_DOT_H
+
+#include "rts-common.h"
+#include "global_state.h"
+
+__CILKRTS_BEGIN_EXTERN_C
+
+// Where workers sit relative to each other, for choosing victims.
+//
+// We only know this when workers are pinned (CILK_PINNING), since an
+// unpinned thread can run anywhere. Without pinning every worker is on
+// socket -1, has no peers, and the functions below return "no
+// preference" so that callers fall back on a uniform random choice.
+
+void worker_topology_init(global_state_t *g);
+void worker_topology_cleanup(global_state_t *g);
+
+// Returns the index of a victim on w's core or socket, chosen with
+// g->steal_core_pct / g->steal_socket_pct, or -1 if the caller should
+// pick from all workers.
+int worker_topology_pick_victim(__cilkrts_worker *w);
+
+// Returns the less loaded (by resumable deques) of two random workers
+// on the given socket, or NULL if socket is unknown.
+__cilkrts_worker* worker_topology_pick_on_socket(__cilkrts_worker *w,
+                                                 int socket);
+
+__CILKRTS_END_EXTERN_C
+
+#endif
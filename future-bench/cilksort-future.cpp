@@ -59,6 +59,13 @@
 #include "internal/abi.h"
 #include "cilk/future.hpp"
 
+#ifdef CILK_SINGLE_FUTURES
+// Every future here is touched exactly once.
+typedef cilk::single_future<void> future_t;
+#else
+typedef cilk::future<void> future_t;
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -316,7 +323,7 @@ ELM *binsplit(ELM val, ELM *low, ELM *high) {
 void cilkmerge(ELM *low1, ELM *high1, 
     ELM *low2, ELM *high2, ELM *lowdest);
 
-void __attribute__((noinline)) cilkmerge_helper(cilk::future<void> *fut, ELM *low1, ELM *high1, 
+void __attribute__((noinline)) cilkmerge_helper(future_t *fut, ELM *low1, ELM *high1, 
     ELM *low2, ELM *high2, ELM *lowdest) {
 
     FUTURE_HELPER_PREAMBLE;
@@ -385,7 +392,7 @@ void __attribute__((noinline)) cilkmerge(ELM *low1, ELM *high1,
    * the appropriate location
    */
   *(lowdest + lowsize + 1) = *split1;
-  cilk::future<void> m;
+  future_t m;
   START_FIRST_FUTURE_SPAWN;
     cilkmerge_helper(&m, low1, split1 - 1, low2, split2, lowdest);
   END_FUTURE_SPAWN;
@@ -400,7 +407,7 @@ void __attribute__((noinline)) cilkmerge(ELM *low1, ELM *high1,
 
 void cilksort(ELM *low, ELM *tmp, long size);
 
-void __attribute__((noinline)) cilksort_helper(cilk::future<void> *fut, ELM *low, ELM *tmp, long size) {
+void __attribute__((noinline)) cilksort_helper(future_t *fut, ELM *low, ELM *tmp, long size) {
     FUTURE_HELPER_PREAMBLE;
 
     cilksort(low, tmp, size);
@@ -440,7 +447,7 @@ void __attribute__((noinline)) cilksort(ELM *low, ELM *tmp, long size) {
   D = C + quarter;
   tmpD = tmpC + quarter;
 
-  cilk::future<void> sort_futures[3];
+  future_t sort_futures[3];
 
   START_FIRST_FUTURE_SPAWN;
     cilksort_helper(&sort_futures[0], A, tmpA, quarter);
@@ -460,7 +467,7 @@ void __attribute__((noinline)) cilksort(ELM *low, ELM *tmp, long size) {
     sort_futures[i].get();
   }
 
-  cilk::future<void> m;
+  future_t m;
   START_FUTURE_SPAWN;
     cilkmerge_helper(&m, A, A + quarter - 1, B, B + quarter - 1, tmpA);
   END_FUTURE_SPAWN;
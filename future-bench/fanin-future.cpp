@@ -0,0 +1,125 @@
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "ktiming.h"
+#include "getoptions.h"
+#include "cilk/future.h"
+
+#ifndef TIMING_COUNT
+#define TIMING_COUNT 10
+#endif
+
+/*
+ * Heavy fan-in stress test for resumable deques.
+ *
+ * nwaiters strands touch a single future before it is ready, so
+ * each of them suspends its deque. One put() then makes all of those
+ * deques resumable at once, and thieves have to pick them up again.
+ * For every run we report how long it took, after the put, until the
+ * median / 99th percentile / last waiter was running again.
+ */
+
+int timing_count = TIMING_COUNT;
+
+static volatile clockmark_t put_mark;
+
+int slow_producer(int spin) {
+    // Give the waiters time to touch the future and suspend
+    volatile int x = 0;
+    for (int i = 0; i < spin; i++) x++;
+
+    put_mark = ktiming_getmark();
+    return 42;
+}
+
+void __attribute__((noinline)) wait_on(cilk::future<int> *fut, clockmark_t *resumed) {
+    int res = cilk_future_get(fut);
+    *resumed = ktiming_getmark();
+    if (res != 42) {
+        fprintf(stderr, "Got %d from the future instead of 42!\n", res);
+        abort();
+    }
+}
+
+void fan_in(cilk::future<int> *fut, clockmark_t *resumed, int lo, int hi) {
+    if (hi - lo == 1) {
+        wait_on(fut, &resumed[lo]);
+        return;
+    }
+
+    int mid = lo + (hi - lo) / 2;
+    cilk_spawn fan_in(fut, resumed, lo, mid);
+    fan_in(fut, resumed, mid, hi);
+    cilk_sync;
+}
+
+// Fills latency with the per-waiter resume latency, and returns how
+// many waiters actually had to suspend.
+int run_once(int nwaiters, int spin, clockmark_t *resumed, uint64_t *latency) {
+    cilk::future<int> *fut;
+
+    cilk_future_create(int, fut, slow_producer, spin);
+    fan_in(fut, resumed, 0, nwaiters);
+    cilk_future_get(fut);
+    delete fut;
+
+    int suspended = 0;
+    for (int i = 0; i < nwaiters; i++) {
+        // Waiters that ran after the put never suspended
+        if (resumed[i] > put_mark) {
+            latency[suspended++] = ktiming_diff_usec((clockmark_t*)&put_mark, &resumed[i]);
+        }
+    }
+    std::sort(latency, latency + suspended);
+    return suspended;
+}
+
+const char *specifiers[] = {"-n", "-spin", "-nruns", 0};
+int opt_types[] = {INTARG, INTARG, INTARG, 0};
+
+int main(int argc, char *argv[]) {
+    int nwaiters = 1024;
+    int spin = 10000000;
+
+    get_options(argc, argv, specifiers, opt_types, &nwaiters, &spin, &timing_count);
+
+    if (nwaiters < 1) {
+        fprintf(stderr, "Usage: fanin [-n waiters] [-spin iters] [-nruns times]\n");
+        exit(1);
+    }
+
+    clockmark_t *resumed = (clockmark_t*) malloc(nwaiters * sizeof(clockmark_t));
+    uint64_t *latency = (uint64_t*) malloc(nwaiters * sizeof(uint64_t));
+    uint64_t *elapsed = (uint64_t*) malloc(timing_count * sizeof(uint64_t));
+
+    for (int i = 0; i < timing_count; i++) {
+        int suspended = run_once(nwaiters, spin, resumed, latency);
+
+        if (suspended == 0) {
+            printf("Run %d: no waiter suspended; try a larger -spin\n", i + 1);
+            elapsed[i] = 0;
+            continue;
+        }
+
+        printf("Run %d: %d/%d waiters suspended, resume latency p50 %gs, p99 %gs, max %gs\n",
+               i + 1, suspended, nwaiters,
+               latency[suspended / 2] * 1.0e-9,
+               latency[(suspended * 99) / 100] * 1.0e-9,
+               latency[suspended - 1] * 1.0e-9);
+        elapsed[i] = latency[suspended - 1];
+    }
+
+    // "Running time" here is the time until the last waiter resumed
+    if (timing_count > 10)
+        print_runtime_summary(elapsed, timing_count);
+    else
+        print_runtime(elapsed, timing_count);
+
+    free(elapsed);
+    free(latency);
+    free(resumed);
+
+    return 0;
+}
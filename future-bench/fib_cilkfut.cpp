@@ -5,6 +5,17 @@
 #include "ktiming.h"
 #include "cilk/future.h"
 
+// fib-sf-lazy and fib-sf-single build this file with FIB_LAZY and
+// FIB_SINGLE, to create each future with cilk_future_create__stack__lazy
+// and cilk_future_create__stack__single respectively.
+#if defined(FIB_LAZY)
+#define fib_future_create cilk_future_create__stack__lazy
+#elif defined(FIB_SINGLE)
+#define fib_future_create cilk_future_create__stack__single
+#else
+#define fib_future_create cilk_future_create__stack
+#endif
+
 #ifndef TIMES_TO_RUN
 #define TIMES_TO_RUN 10
 #endif
@@ -26,7 +37,7 @@ int fib(int n) {
         return n;
     }
     
-    cilk_future_create__stack(int, x_fut, fib, n-1);
+    fib_future_create(int, x_fut, fib, n-1);
     //x =  fib(n - 1);
     y = fib(n - 2);
     x = x_fut.get();//cilk_future_get(x_fut);
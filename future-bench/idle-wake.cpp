@@ -0,0 +1,138 @@
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include "ktiming.h"
+#include "getoptions.h"
+#include "cilk/future.h"
+
+#ifndef TIMING_COUNT
+#define TIMING_COUNT 10
+#endif
+
+/*
+ * Idle workers: how much CPU they burn and how fast they wake up.
+ *
+ * First the program strand sleeps for a while with nothing to steal,
+ * and we report how many cores' worth of CPU time the process used in
+ * the meantime. Then, still after a quiet period, it creates a future
+ * whose body spins until its parent's continuation has been stolen.
+ * The wake-to-run latency is the time from just before the create
+ * until the continuation starts running on the thief.
+ *
+ * The same is done with a plain cilk_spawn, which the compiler inlines
+ * and so never tells the runtime that there is new work; that case
+ * shows the worst-case wake-up latency (the park timeout).
+ */
+
+int timing_count = TIMING_COUNT;
+
+// Give up on a thief after this long; with one worker there is none.
+#define GUARD_NS 1000000000ULL
+
+static volatile int stolen;
+static volatile clockmark_t run_mark;
+
+static double cpu_seconds() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec
+        + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1.0e-6;
+}
+
+int wait_for_thief() {
+    clockmark_t begin = ktiming_getmark();
+    while (!stolen) {
+        clockmark_t now = ktiming_getmark();
+        if (now - begin > GUARD_NS) return 0;
+    }
+    return 1;
+}
+
+// Returns the cores' worth of CPU used over idle_ms of doing nothing.
+double idle_cpu(int idle_ms) {
+    double cpu_begin = cpu_seconds();
+    clockmark_t begin = ktiming_getmark();
+    usleep(idle_ms * 1000);
+    clockmark_t end = ktiming_getmark();
+    double cpu_end = cpu_seconds();
+
+    return (cpu_end - cpu_begin) / (ktiming_diff_usec(&begin, &end) * 1.0e-9);
+}
+
+// Both return the latency in ns, or 0 if nobody stole the continuation.
+uint64_t __attribute__((noinline)) future_wake(int idle_ms) {
+    usleep(idle_ms * 1000);
+    stolen = 0;
+
+    cilk::future<int> *fut;
+    clockmark_t begin = ktiming_getmark();
+    cilk_future_create(int, fut, wait_for_thief);
+    run_mark = ktiming_getmark();
+    stolen = 1;
+
+    int ok = cilk_future_get(fut);
+    delete fut;
+    return ok ? ktiming_diff_usec(&begin, (clockmark_t*)&run_mark) : 0;
+}
+
+uint64_t __attribute__((noinline)) spawn_wake(int idle_ms) {
+    usleep(idle_ms * 1000);
+    stolen = 0;
+
+    clockmark_t begin = ktiming_getmark();
+    int ok = cilk_spawn wait_for_thief();
+    run_mark = ktiming_getmark();
+    stolen = 1;
+
+    cilk_sync;
+    return ok ? ktiming_diff_usec(&begin, (clockmark_t*)&run_mark) : 0;
+}
+
+const char *specifiers[] = {"-idle", "-nruns", 0};
+int opt_types[] = {INTARG, INTARG, 0};
+
+int main(int argc, char *argv[]) {
+    int idle_ms = 100;
+
+    get_options(argc, argv, specifiers, opt_types, &idle_ms, &timing_count);
+
+    if (idle_ms < 1) {
+        fprintf(stderr, "Usage: idle-wake [-idle ms] [-nruns times]\n");
+        exit(1);
+    }
+
+    uint64_t *elapsed = (uint64_t*) malloc(timing_count * sizeof(uint64_t));
+    int missed = 0;
+
+    // Get the workers going before we start measuring.
+    spawn_wake(1);
+
+    for (int i = 0; i < timing_count; i++) {
+        double cores = idle_cpu(idle_ms);
+        uint64_t fut_ns = future_wake(idle_ms);
+        uint64_t spawn_ns = spawn_wake(idle_ms);
+        if (!fut_ns || !spawn_ns) missed++;
+
+        printf("Run %d: %.3f cores busy while idle, wake-to-run %g us (future), %g us (spawn)\n",
+               i + 1, cores, fut_ns * 1.0e-3, spawn_ns * 1.0e-3);
+        elapsed[i] = fut_ns;
+    }
+
+    if (missed)
+        printf("%d runs had no thief within %g s\n", missed, GUARD_NS * 1.0e-9);
+
+    // The summary is of the future wake-to-run latency.
+    if (timing_count > 10)
+        print_runtime_summary(elapsed, timing_count);
+    else
+        print_runtime(elapsed, timing_count);
+
+    free(elapsed);
+
+    return 0;
+}
@@ -33,6 +33,13 @@ int timing_count = TIMING_COUNT;
 
 #include "cilk/future.h"
 
+#ifdef CILK_SINGLE_FUTURES
+// Every future here is touched exactly once.
+typedef cilk::single_future<void> future_t;
+#else
+typedef cilk::future<void> future_t;
+#endif
+
 #define REAL int
 static int BASE_CASE; //the base case of the computation (2*POWER)
 static int POWER; //the power of two the base case is based on
@@ -229,9 +236,9 @@ double maxerror_rm(REAL *M1, REAL *M2, int n) {
     return err;
 }
 
-void mat_mul_par(const REAL *const A, const REAL *const B, REAL *C, cilk::future<void> *CReady, int n);
+void mat_mul_par(const REAL *const A, const REAL *const B, REAL *C, future_t *CReady, int n);
 
-void __attribute__((noinline)) mat_mul_par_helper(const REAL *const A, const REAL *const B, REAL *C, cilk::future<void> *CReady, int n) {
+void __attribute__((noinline)) mat_mul_par_helper(const REAL *const A, const REAL *const B, REAL *C, future_t *CReady, int n) {
   SPAWN_HELPER_PREAMBLE;
 
   mat_mul_par(A, B, C, CReady, n);
@@ -239,7 +246,7 @@ void __attribute__((noinline)) mat_mul_par_helper(const REAL *const A, const REA
   SPAWN_HELPER_EPILOGUE;
 }
 
-void __attribute__((noinline)) mat_mul_par_fut_helper(cilk::future<void> *fut, const REAL *const A, const REAL *const B, REAL *C, cilk::future<void> *CReady, int n) {
+void __attribute__((noinline)) mat_mul_par_fut_helper(future_t *fut, const REAL *const A, const REAL *const B, REAL *C, future_t *CReady, int n) {
     FUTURE_HELPER_PREAMBLE;
 
     mat_mul_par(A, B, C, CReady, n);
@@ -250,7 +257,7 @@ void __attribute__((noinline)) mat_mul_par_fut_helper(cilk::future<void> *fut, c
 }
 
 //recursive parallel solution to matrix multiplication
-void mat_mul_par(const REAL *const A, const REAL *const B, REAL *C, cilk::future<void> *CReady, int n){
+void mat_mul_par(const REAL *const A, const REAL *const B, REAL *C, future_t *CReady, int n){
 
     if (CReady) {
       CReady->get();
@@ -292,7 +299,7 @@ void mat_mul_par(const REAL *const A, const REAL *const B, REAL *C, cilk::future
     REAL *C3 = &C[block_convert(n >> 1,0)];
     REAL *C4 = &C[block_convert(n >> 1, n >> 1)];
 
-    cilk::future<void> stages[4];// = new cilk::future<void>[4];
+    future_t stages[4];// = new future_t[4];
     START_FIRST_FUTURE_SPAWN;
       mat_mul_par_fut_helper(&stages[0], A1, B1, C1, CReady, n>>1);
     END_FUTURE_SPAWN;
@@ -0,0 +1,107 @@
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ktiming.h"
+#include "getoptions.h"
+#include "internal/abi.h"
+#include "cilk/future.h"
+
+#ifndef TIMING_COUNT
+#define TIMING_COUNT 10
+#endif
+
+/*
+ * Suspend/resume round trip.
+ *
+ * Two strands hand a counter back and forth through two arrays of
+ * futures. Each one touches the next future before the other side
+ * has put it, so nearly every round suspends a deque on each side and
+ * makes it resumable again. The time per round is dominated by the
+ * cost of suspending and resuming a deque.
+ *
+ * Built with -DPINGPONG_SPIN (pingpong-spin), each side touches with
+ * get_or_spin() instead, so a round only suspends if the other side
+ * takes longer than CILK_GET_SPINS to answer.
+ */
+
+int timing_count = TIMING_COUNT;
+
+#ifdef PINGPONG_SPIN
+#define TOUCH(fut) (fut).get_or_spin()
+#else
+#define TOUCH(fut) (fut).get()
+#endif
+
+static inline void put_and_wake(cilk::future<int> *fut, int val) {
+    void *d = fut->put(val);
+    if (d) __cilkrts_make_resumable(d);
+}
+
+void pong_side(cilk::future<int> *ping, cilk::future<int> *pong, int rounds) {
+    for (int i = 0; i < rounds; i++) {
+        int v = TOUCH(ping[i]);
+        put_and_wake(&pong[i], v + 1);
+    }
+}
+
+int ping_side(cilk::future<int> *ping, cilk::future<int> *pong, int rounds) {
+    cilk::future<void> done;
+    cilk::spawn_future(&done, pong_side, ping, pong, rounds);
+
+    int v = 0;
+    for (int i = 0; i < rounds; i++) {
+        put_and_wake(&ping[i], v);
+        v = TOUCH(pong[i]);
+    }
+
+    done.get();
+    return v;
+}
+
+const char *specifiers[] = {"-n", "-nruns", 0};
+int opt_types[] = {INTARG, INTARG, 0};
+
+int main(int argc, char *argv[]) {
+    int rounds = 100000;
+
+    get_options(argc, argv, specifiers, opt_types, &rounds, &timing_count);
+
+    if (rounds < 1) {
+        fprintf(stderr, "Usage: pingpong [-n rounds] [-nruns times]\n");
+        exit(1);
+    }
+
+    cilk::future<int> *ping = new cilk::future<int>[rounds];
+    cilk::future<int> *pong = new cilk::future<int>[rounds];
+    uint64_t *elapsed = (uint64_t*) malloc(timing_count * sizeof(uint64_t));
+
+    for (int i = 0; i < timing_count; i++) {
+        for (int j = 0; j < rounds; j++) {
+            ping[j].reset();
+            pong[j].reset();
+        }
+
+        clockmark_t begin = ktiming_getmark();
+        int res = ping_side(ping, pong, rounds);
+        clockmark_t end = ktiming_getmark();
+        elapsed[i] = ktiming_diff_usec(&begin, &end);
+
+        if (res != rounds) {
+            fprintf(stderr, "Got %d after %d rounds!\n", res, rounds);
+            abort();
+        }
+        printf("Run %d: %g us per round trip\n", i + 1, elapsed[i] * 1.0e-3 / rounds);
+    }
+
+    if (timing_count > 10)
+        print_runtime_summary(elapsed, timing_count);
+    else
+        print_runtime(elapsed, timing_count);
+
+    free(elapsed);
+    delete [] pong;
+    delete [] ping;
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <cilk/cilk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include "ktiming.h"
+#include "getoptions.h"
+#include "internal/abi.h"
+#include "cilk/future.h"
+
+#ifndef TIMING_COUNT
+#define TIMING_COUNT 10
+#endif
+
+/*
+ * Worst-case put() latency.
+ *
+ * Same setup as fanin: nwaiters strands suspend on one future before
+ * it is ready. Here we time the put() call itself in the producer,
+ * i.e. how long the producing strand is held up by the waiter list
+ * before it can go on with its own work. The producer is written with
+ * the hand-compiled future macros so the timer sits right around the
+ * put(), before the first waiter is resumed.
+ */
+
+int timing_count = TIMING_COUNT;
+
+#define NO_PUT_TIME UINT64_MAX
+
+void __attribute__((noinline))
+producer(cilk::future<int> *fut, int spin, volatile uint64_t *put_time) {
+    FUTURE_HELPER_PREAMBLE;
+
+    // Give the waiters time to touch the future and suspend
+    volatile int x = 0;
+    for (int i = 0; i < spin; i++) x++;
+
+    clockmark_t begin = ktiming_getmark();
+    void *__cilk_deque = fut->put(42);
+    clockmark_t end = ktiming_getmark();
+    *put_time = ktiming_diff_usec(&begin, &end);
+
+    if (__builtin_expect(__cilk_deque != NULL, 0)) {
+            __cilkrts_resume_suspended(__cilk_deque, 2);
+    }
+
+    FUTURE_HELPER_EPILOGUE;
+}
+
+void __attribute__((noinline)) wait_on(cilk::future<int> *fut) {
+    int res = fut->get();
+    if (res != 42) {
+        fprintf(stderr, "Got %d from the future instead of 42!\n", res);
+        abort();
+    }
+}
+
+void fan_in(cilk::future<int> *fut, int n) {
+    if (n == 1) {
+        wait_on(fut);
+        return;
+    }
+
+    cilk_spawn fan_in(fut, n / 2);
+    fan_in(fut, n - n / 2);
+    cilk_sync;
+}
+
+uint64_t __attribute__((noinline)) run_once(int nwaiters, int spin) {
+    CILK_FUNC_PREAMBLE;
+
+    volatile uint64_t put_time = NO_PUT_TIME;
+    cilk::future<int> fut = cilk::future<int>();
+
+    START_FIRST_FUTURE_SPAWN;
+        producer(&fut, spin, &put_time);
+    END_FUTURE_SPAWN;
+
+    fan_in(&fut, nwaiters);
+    fut.get();
+
+    // The producer records the time right after its put(), but we
+    // may have been resumed by a thief before it got there.
+    while (put_time == NO_PUT_TIME);
+
+    CILK_FUNC_EPILOGUE;
+    return put_time;
+}
+
+const char *specifiers[] = {"-n", "-spin", "-nruns", 0};
+int opt_types[] = {INTARG, INTARG, INTARG, 0};
+
+int main(int argc, char *argv[]) {
+    int nwaiters = 1024;
+    int spin = 10000000;
+
+    get_options(argc, argv, specifiers, opt_types, &nwaiters, &spin, &timing_count);
+
+    if (nwaiters < 1) {
+        fprintf(stderr, "Usage: put-latency [-n waiters] [-spin iters] [-nruns times]\n");
+        exit(1);
+    }
+
+    uint64_t *elapsed = (uint64_t*) malloc(timing_count * sizeof(uint64_t));
+
+    for (int i = 0; i < timing_count; i++) {
+        elapsed[i] = run_once(nwaiters, spin);
+        printf("Run %d: put() took %gs\n", i + 1, elapsed[i] * 1.0e-9);
+    }
+
+    uint64_t worst = *std::max_element(elapsed, elapsed + timing_count);
+    printf("Worst put(): %gs\n", worst * 1.0e-9);
+
+    // "Running time" here is the time spent inside put()
+    if (timing_count > 10)
+        print_runtime_summary(elapsed, timing_count);
+    else
+        print_runtime(elapsed, timing_count);
+
+    free(elapsed);
+
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <algorithm>
+#include <random>
+#include "ktiming.h"
+#include "getoptions.h"
+
+#if defined(STREAM_STD)
+#include <future>
+#define VARIANT "std-async"
+#elif defined(STREAM_FJ)
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#define VARIANT "cilkplus"
+#else
+#include <cilk/cilk.h>
+#include <cilk/cilk_api.h>
+#include "cilk/future.h"
+#ifdef STREAM_WHEN_ALL
+#define VARIANT "future-when-all"
+#else
+#define VARIANT "future"
+#endif
+#endif
+
+#ifndef TIMING_COUNT
+#define TIMING_COUNT 10
+#endif
+
+/*
+ * Open-loop request/response stream.
+ *
+ * Requests arrive at a fixed average rate (exponential inter-arrival
+ * times, fixed seed), whether or not earlier ones have finished, the
+ * way they would at a server. Each request is a small DAG: fanout
+ * leaves that each do some work, then a step that combines their
+ * results. A request's latency runs from its scheduled arrival time,
+ * not from when the generator got around to it, so a backlog shows up
+ * in the tail instead of being hidden.
+ *
+ * Built four ways from this file:
+ *   stream-sf  - futures on cilkrtssuspend (default)
+ *   stream-sf-join - the same, but with one cilk::when_all on the
+ *                leaves before reading them (-DSTREAM_WHEN_ALL)
+ *   stream-fj  - cilk_spawn/cilk_sync on vanilla cilkplus-rts (-DSTREAM_FJ)
+ *   stream-std - std::async threads, as in ferret-std-future (-DSTREAM_STD)
+ *
+ * Besides the usual running time summary, every run prints one line
+ *   csv,<variant>,<P>,<rate>,<throughput>,<p50 us>,<p99 us>,<p999 us>
+ * which run-benchmarks.py collects.
+ */
+
+int timing_count = TIMING_COUNT;
+
+static int fanout = 8;
+static int work = 10000;
+
+static clockmark_t *arrival;
+static clockmark_t *done;
+
+int __attribute__((noinline)) leaf(int seed) {
+    volatile int x = seed;
+    for (int i = 0; i < work; i++) x = x * 31 + i;
+    return x & 1;
+}
+
+#if defined(STREAM_STD)
+
+void handle(int r) {
+    std::future<int> *leaves = new std::future<int>[fanout];
+    for (int j = 0; j < fanout; j++)
+        leaves[j] = std::async(std::launch::async, leaf, r + j);
+
+    int sum = 0;
+    for (int j = 0; j < fanout; j++) sum += leaves[j].get();
+    delete [] leaves;
+
+    done[r] = ktiming_getmark();
+    if (sum > fanout) abort();
+}
+
+#elif defined(STREAM_FJ)
+
+void handle_range(int r, int *res, int lo, int hi) {
+    if (hi - lo == 1) {
+        res[lo] = leaf(r + lo);
+        return;
+    }
+    int mid = lo + (hi - lo) / 2;
+    cilk_spawn handle_range(r, res, lo, mid);
+    handle_range(r, res, mid, hi);
+    cilk_sync;
+}
+
+void handle(int r) {
+    int *res = new int[fanout];
+    handle_range(r, res, 0, fanout);
+
+    int sum = 0;
+    for (int j = 0; j < fanout; j++) sum += res[j];
+    delete [] res;
+
+    done[r] = ktiming_getmark();
+    if (sum > fanout) abort();
+}
+
+#else
+
+void handle(int r) {
+    cilk::future<int> *leaves = new cilk::future<int>[fanout];
+    for (int j = 0; j < fanout; j++)
+        cilk::spawn_future(&leaves[j], leaf, r + j);
+
+#ifdef STREAM_WHEN_ALL
+    cilk::when_all(leaves, fanout);
+#endif
+    int sum = 0;
+    for (int j = 0; j < fanout; j++) sum += leaves[j].get();
+    delete [] leaves;
+
+    done[r] = ktiming_getmark();
+    if (sum > fanout) abort();
+}
+
+#endif
+
+static inline void wait_until(clockmark_t t) {
+    while (ktiming_getmark() < t) ;
+}
+
+// Issues all n requests on schedule and waits for them to finish.
+void generate(int n) {
+#if defined(STREAM_STD)
+    std::future<void> *reqs = new std::future<void>[n];
+    for (int r = 0; r < n; r++) {
+        wait_until(arrival[r]);
+        reqs[r] = std::async(std::launch::async, handle, r);
+    }
+    for (int r = 0; r < n; r++) reqs[r].get();
+    delete [] reqs;
+#elif defined(STREAM_FJ)
+    for (int r = 0; r < n; r++) {
+        wait_until(arrival[r]);
+        cilk_spawn handle(r);
+    }
+    cilk_sync;
+#else
+    cilk::future<void> *reqs = new cilk::future<void>[n];
+    for (int r = 0; r < n; r++) {
+        wait_until(arrival[r]);
+        cilk::spawn_future(&reqs[r], handle, r);
+    }
+    for (int r = 0; r < n; r++) reqs[r].get();
+    delete [] reqs;
+#endif
+}
+
+static int num_workers() {
+#if defined(STREAM_STD)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        return CPU_COUNT(&set);
+    return 1;
+#else
+    return __cilkrts_get_nworkers();
+#endif
+}
+
+const char *specifiers[] = {"-n", "-rate", "-fanout", "-work", "-nruns", 0};
+int opt_types[] = {INTARG, INTARG, INTARG, INTARG, INTARG, 0};
+
+int main(int argc, char *argv[]) {
+    int n = 10000;
+    int rate = 10000;
+
+    get_options(argc, argv, specifiers, opt_types,
+                &n, &rate, &fanout, &work, &timing_count);
+
+    if (n < 1 || rate < 1 || fanout < 1 || work < 0) {
+        fprintf(stderr, "Usage: stream [-n requests] [-rate requests/s] "
+                "[-fanout leaves] [-work iters] [-nruns times]\n");
+        exit(1);
+    }
+
+    // Offsets from the start of a run, in ns
+    uint64_t *offset = (uint64_t*) malloc(n * sizeof(uint64_t));
+    std::mt19937_64 rng(12345);
+    std::exponential_distribution<double> gap(rate * 1.0e-9);
+    double t = 0;
+    for (int r = 0; r < n; r++) {
+        offset[r] = (uint64_t) t;
+        t += gap(rng);
+    }
+
+    arrival = (clockmark_t*) malloc(n * sizeof(clockmark_t));
+    done = (clockmark_t*) malloc(n * sizeof(clockmark_t));
+    uint64_t *latency = (uint64_t*) malloc(n * sizeof(uint64_t));
+    uint64_t *elapsed = (uint64_t*) malloc(timing_count * sizeof(uint64_t));
+    int P = num_workers();
+
+    for (int i = 0; i < timing_count; i++) {
+        clockmark_t begin = ktiming_getmark();
+        for (int r = 0; r < n; r++) arrival[r] = begin + offset[r];
+
+        generate(n);
+
+        clockmark_t end = begin;
+        for (int r = 0; r < n; r++) {
+            latency[r] = ktiming_diff_usec(&arrival[r], &done[r]);
+            end = std::max(end, done[r]);
+        }
+        elapsed[i] = ktiming_diff_usec(&begin, &end);
+        std::sort(latency, latency + n);
+
+        double throughput = n / (elapsed[i] * 1.0e-9);
+        double p50 = latency[(n - 1) / 2] * 1.0e-3;
+        double p99 = latency[(int)((n - 1) * 0.99)] * 1.0e-3;
+        double p999 = latency[(int)((n - 1) * 0.999)] * 1.0e-3;
+
+        printf("Run %d: %g requests/s, latency p50 %g us, p99 %g us, p999 %g us\n",
+               i + 1, throughput, p50, p99, p999);
+        printf("csv,%s,%d,%d,%g,%g,%g,%g\n",
+               VARIANT, P, rate, throughput, p50, p99, p999);
+    }
+
+    if (timing_count > 10)
+        print_runtime_summary(elapsed, timing_count);
+    else
+        print_runtime(elapsed, timing_count);
+
+    free(elapsed);
+    free(latency);
+    free(done);
+    free(arrival);
+    free(offset);
+
+    return 0;
+}
@@ -304,7 +304,24 @@ int __attribute__((noinline)) wave_lcs_with_futures(int *stor, char *a, char *b,
 #endif
 
 #ifdef NONBLOCKING_FUTURES
-static int process_lcs_tile_with_get(cilk::future<int> *farray, int *stor,
+#ifdef PADDED_FUTURES
+// Each tile's future on its own cache line. The array is allocated on
+// the first run and reset for each later one.
+typedef cilk::padded_future<int> tile_future;
+static cilk::future_array<int> *tile_futures = NULL;
+
+static tile_future* get_tile_futures(int blocks) {
+  if (!tile_futures)
+    tile_futures = new cilk::future_array<int>(blocks);
+  else
+    tile_futures->reset();
+  return tile_futures->data();
+}
+#else
+typedef cilk::future<int> tile_future;
+#endif
+
+static int process_lcs_tile_with_get(tile_future *farray, int *stor,
                                      char *a, char *b, int n, int iB, int jB) {
 
   int nBlocks = NUM_BLOCKS(n);
@@ -317,109 +334,6 @@ static int process_lcs_tile_with_get(cilk::future<int> *farray, int *stor,
   return 0;
 }
 
-void __attribute__((noinline)) process_lcs_tile_with_get_helper(cilk::future<int> *fut, cilk::future<int> *farray,
-                                      int *stor, char *a, char *b, int n, int iB, int jB) {
-  FUTURE_HELPER_PREAMBLE;
-
-  void *__cilkrts_deque = fut->put(process_lcs_tile_with_get(farray, stor, a, b, n, iB, jB));
-
-  if (__cilkrts_deque) __cilkrts_make_resumable(__cilkrts_deque);
-
-  FUTURE_HELPER_EPILOGUE;
-}
-
-/*typedef struct wave_lcs_loop_context_t {
-  int nBlocks;
-  cilk::future<int> *farray;
-  int *stor;
-  char *a;
-  char *b;
-  int n;
-} wave_lcs_loop_context_t;
-
-void __attribute__((noinline)) wave_lcs_loop_body(void* context, uint32_t start, uint32_t end) {
-  CILK_FUNC_PREAMBLE;
-
-  wave_lcs_loop_context_t *ctx = (wave_lcs_loop_context_t*) context;
-
-  for (uint32_t i = start; i < end; i++) {
-    int iB = i / ctx->nBlocks;
-    int jB = i % ctx->nBlocks;
-
-    //cilk_fiber *initial_fiber = cilk_fiber_get_current_fiber();
-    //sf.flags |= CILK_FRAME_FUTURE_PARENT;
-    //if (!CILK_SETJMP(cilk_fiber_get_resume_jmpbuf(initial_fiber))) {
-    //    char *new_sp = __cilkrts_switch_fibers();
-    //    char *old_sp = NULL;
-
-    //    __asm__ volatile ("mov %%rsp, %0" : "=r" (old_sp));
-    //    __asm__ volatile ("mov %0, %%rsp" : : "r" (new_sp));
-    START_FIRST_FUTURE_SPAWN;
-        process_lcs_tile_with_get_helper(&ctx->farray[i], ctx->farray, ctx->stor, ctx->a, ctx->b, ctx->n, iB, jB);
-    END_FUTURE_SPAWN;
-
-    //    __asm__ volatile ("mov %0, %%rsp" : : "r" (old_sp));
-
-    //    __cilkrts_switch_fibers_back(initial_fiber);
-    //}
-    //cilk_fiber_do_post_switch_actions(initial_fiber);
-    //sf.flags &= ~(CILK_FRAME_FUTURE_PARENT);
-    //use_future_inplace(int,&ctx->farray[i], process_lcs_tile_with_get, ctx->farray, ctx->stor, ctx->a, ctx->b, ctx->n, iB, jB);
-  }
-
-  CILK_FUNC_EPILOGUE;
-}
-
-
-extern "C" {
-  void __cilkrts_cilk_for_32(void (*body) (void *, uint32_t, uint32_t),
-      void *context, uint32_t count, int grain);
-}
-*/
-
-static void __attribute__((noinline)) launch_lcs_gf(int *stor, char *a, char *b, int n, int nBlocks, cilk::future<int>* farray, int loc) {
-  CILK_FUNC_PREAMBLE;
-  
-  int iB = loc / nBlocks;
-  int jB = loc % nBlocks;
-
-  START_FIRST_FUTURE_SPAWN;
-      process_lcs_tile_with_get_helper(&farray[loc], farray, stor, a, b, n, iB, jB);
-  END_FUTURE_SPAWN;
-
-  CILK_FUNC_EPILOGUE;
-}
-
-static void recursive_wave_lcs_with_futures(int *stor, char *a, char *b, int n, int nBlocks, cilk::future<int>* farray, int start, int end);
-
-static void __attribute__((noinline)) recursive_wave_lcs_with_futures_helper(int *stor, char *a, char *b, int n, int nBlocks, cilk::future<int>* farray, int start, int end) {
-    SPAWN_HELPER_PREAMBLE;
-
-    recursive_wave_lcs_with_futures(stor, a, b, n, nBlocks, farray, start, end);
-
-    SPAWN_HELPER_EPILOGUE;
-}
-
-static void recursive_wave_lcs_with_futures(int *stor, char *a, char *b, int n, int nBlocks, cilk::future<int>* farray, int start, int end) {
-  CILK_FUNC_PREAMBLE;
-
-  int count = end - start;
-  int mid;
-
-  while (count > 1) {
-    mid = start + count/2;
-    //cilk_spawn recursive_wave_sw_with_futures(stor, a, b, n, nBlocks, farray, start, mid);
-    if (!CILK_SETJMP(sf.ctx)) {
-      recursive_wave_lcs_with_futures_helper(stor, a, b, n, nBlocks, farray, start, mid);
-    }
-    start = mid;
-    count = end - start;
-  }
-
-  launch_lcs_gf(stor, a, b, n, nBlocks, farray, start);
-  CILK_FUNC_EPILOGUE;
-}
-
 int __attribute__((noinline)) wave_lcs_with_futures(int *stor, char *a, char *b, int n) {
   CILK_FUNC_PREAMBLE;
 
@@ -427,29 +341,24 @@ int __attribute__((noinline)) wave_lcs_with_futures(int *stor, char *a, char *b,
   int blocks = nBlocks * nBlocks;
 
   // create an array of future handles
-  //auto farray = (cilk::future<int>*)
-  //  malloc(sizeof(cilk::future<int>) * blocks);
-  cilk::future<int> *farray = new cilk::future<int>[blocks];
-
-  /*wave_lcs_loop_context_t ctx = {
-    .nBlocks = nBlocks,
-    .farray = farray,
-    .stor = stor,
-    .a = a,
-    .b = b,
-    .n = n,
-  };
-  __cilkrts_cilk_for_32(wave_lcs_loop_body, &ctx, blocks, 0);
-  */
-  recursive_wave_lcs_with_futures(stor, a, b, n, nBlocks, farray, 0, blocks);
+#ifdef PADDED_FUTURES
+  tile_future *farray = get_tile_futures(blocks);
+#else
+  tile_future *farray = new tile_future[blocks];
+#endif
+
+  cilk::future_for(farray, 0, blocks, [=](size_t i) {
+    return process_lcs_tile_with_get(farray, stor, a, b, n, i / nBlocks, i % nBlocks);
+  });
 
   // make sure the last square finishes before we move onto returning
   farray[blocks-1].get();
 
   CILK_FUNC_EPILOGUE;
 
-  //free(farray);
+#ifndef PADDED_FUTURES
   delete [] farray;
+#endif
 
   return stor[n*(n-1) + n-1];
 }
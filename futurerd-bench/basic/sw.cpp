@@ -238,7 +238,24 @@ static int __attribute__((noinline)) wave_sw_with_futures(int *stor, char *a, ch
 #endif
 
 #ifdef NONBLOCKING_FUTURES
-static int process_sw_tile_with_get(cilk::future<void> * farray, int *stor,
+#ifdef PADDED_FUTURES
+// Each tile's future on its own cache line. The array is allocated on
+// the first run and reset for each later one.
+typedef cilk::padded_future<void> tile_future;
+static cilk::future_array<void> *tile_futures = NULL;
+
+static tile_future* get_tile_futures(int blocks) {
+  if (!tile_futures)
+    tile_futures = new cilk::future_array<void>(blocks);
+  else
+    tile_futures->reset();
+  return tile_futures->data();
+}
+#else
+typedef cilk::future<void> tile_future;
+#endif
+
+static int process_sw_tile_with_get(tile_future *farray, int *stor,
                                     char *a, char *b, int n, int iB, int jB) {
     
   int nBlocks = NUM_BLOCKS(n);
@@ -255,111 +272,27 @@ static int process_sw_tile_with_get(cilk::future<void> * farray, int *stor,
   return 0;
 }
 
-void __attribute__((noinline)) process_sw_tile_with_get_helper(cilk::future<void> *fut, cilk::future<void> *farray, int *stor,
-                                                               char *a, char *b, int n, int iB, int jB) {
-
-  FUTURE_HELPER_PREAMBLE;
-
-  process_sw_tile_with_get(farray, stor, a, b, n, iB, jB);
-  void* __cilkrts_deque = fut->put();
-  if (__cilkrts_deque) __cilkrts_make_resumable(__cilkrts_deque);
-
-  FUTURE_HELPER_EPILOGUE;
-}
-
-//typedef struct wave_sw_context_t {
-//  int nBlocks;
-//  cilk::future<void> *farray;
-//  int *stor;
-//  char *a;
-//  char *b;
-//  int n;
-//} wave_sw_context_t;
-
-//void wave_sw_with_futures_loop_body(void *context, uint32_t start, uint32_t end) {
-//  CILK_FUNC_PREAMBLE;
-//
-//  wave_sw_context_t *ctx = (wave_sw_context_t*)context;
-//
-//  for (int i = start; i < end; i++) {
-//    int iB = i / ctx->nBlocks; // row block index 
-//    int jB = i % ctx->nBlocks; // col block index
-//    START_FIRST_FUTURE_SPAWN;
-//        process_sw_tile_with_get_helper(&ctx->farray[i], ctx->farray, ctx->stor, ctx->a, ctx->b, ctx->n, iB, jB);
-//    END_FUTURE_SPAWN;
-//  }
-//
-//  CILK_FUNC_EPILOGUE;
-//}
-
-static void __attribute__((noinline)) launch_sw_gf(int *stor, char *a, char *b, int n, int nBlocks, cilk::future<void>* farray, int loc) {
-  CILK_FUNC_PREAMBLE;
-  
-  int iB = loc / nBlocks;
-  int jB = loc % nBlocks;
-
-  START_FIRST_FUTURE_SPAWN;
-      process_sw_tile_with_get_helper(&farray[loc], farray, stor, a, b, n, iB, jB);
-  END_FUTURE_SPAWN;
-
-  CILK_FUNC_EPILOGUE;
-}
-
-static void recursive_wave_sw_with_futures(int *stor, char *a, char *b, int n, int nBlocks, cilk::future<void>* farray, int start, int end);
-
-static void __attribute__((noinline)) recursive_wave_sw_with_futures_helper(int *stor, char *a, char *b, int n, int nBlocks, cilk::future<void>* farray, int start, int end) {
-    SPAWN_HELPER_PREAMBLE;
-
-    recursive_wave_sw_with_futures(stor, a, b, n, nBlocks, farray, start, end);
-
-    SPAWN_HELPER_EPILOGUE;
-}
-
-static void __attribute__((noinline)) recursive_wave_sw_with_futures(int *stor, char *a, char *b, int n, int nBlocks, cilk::future<void>* farray, int start, int end) {
-  CILK_FUNC_PREAMBLE;
-
-  int count = end - start;
-  int mid;
-
-  while (count > 1) {
-    mid = start + count/2;
-    //cilk_spawn recursive_wave_sw_with_futures(stor, a, b, n, nBlocks, farray, start, mid);
-    if (!CILK_SETJMP(sf.ctx)) {
-      recursive_wave_sw_with_futures_helper(stor, a, b, n, nBlocks, farray, start, mid);
-    }
-    start = mid;
-    count = end - start;
-  }
-
-  launch_sw_gf(stor, a, b, n, nBlocks, farray, start);
-  CILK_FUNC_EPILOGUE;
-}
-
 static int wave_sw_with_futures(int *stor, char *a, char *b, int n) {
 
   int nBlocks = NUM_BLOCKS(n);
   int blocks = nBlocks * nBlocks;
     
-  //auto *farray = (cilk::future<void>*)
-  //  malloc(sizeof(cilk::future<void>) * blocks);
-  cilk::future<void>* farray = new cilk::future<void>[blocks];
-
-  //wave_sw_context_t ctx = {
-  //  .nBlocks = nBlocks,
-  //  .farray = farray,
-  //  .stor = stor,
-  //  .a = a,
-  //  .b = b,
-  //  .n = n
-  //};
-  //__cilkrts_cilk_for_32(wave_sw_with_futures_loop_body, &ctx, blocks, 0);
-  recursive_wave_sw_with_futures(stor, a, b, n, nBlocks, farray, 0, blocks);
+#ifdef PADDED_FUTURES
+  tile_future *farray = get_tile_futures(blocks);
+#else
+  tile_future *farray = new tile_future[blocks];
+#endif
+
+  cilk::future_for(farray, 0, blocks, [=](size_t i) {
+    process_sw_tile_with_get(farray, stor, a, b, n, i / nBlocks, i % nBlocks);
+  });
   
   // make sure the last square finishes before we move onto returning
   farray[blocks-1].get();
 
-  //free(farray);
+#ifndef PADDED_FUTURES
   delete [] farray;
+#endif
     
   return stor[n*(n-1) + n-1];
 }
@@ -65,6 +65,7 @@ int main(int argc, char* argv[]) {
     }
   }
 
+  print_rss("before");
   auto start = std::chrono::steady_clock::now();
   __asm__ volatile ("" ::: "memory");
   t1->merge(t2);
@@ -92,6 +93,7 @@ int main(int argc, char* argv[]) {
   auto time = std::chrono::duration <double, std::milli> (end-start).count();
   printf("%s: s1=%zu s2=%zu\n", argv[0], t1_size, t2_size);
   printf("Benchmark time: %f ms\n", time);
+  print_rss("after");
 
   delete t1; // The merge takes care of t2
 
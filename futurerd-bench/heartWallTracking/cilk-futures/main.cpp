@@ -618,6 +618,7 @@ int main(int argc, char *argv []) {
     //	KERNEL
     //=====================
 
+    print_rss("before");
     auto start = std::chrono::steady_clock::now();
 
     CILK_FUNC_PREAMBLE;
@@ -681,6 +682,7 @@ int main(int argc, char *argv []) {
     auto end = std::chrono::steady_clock::now();
     auto time = std::chrono::duration <double, std::milli> (end-start).count();
     printf("Benchmark time: %f ms\n", time);
+    print_rss("after");
 
     //=====================
     //	DEALLOCATION
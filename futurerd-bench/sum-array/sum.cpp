@@ -10,23 +10,10 @@
 typedef struct pair_t {
     unsigned long n;
     cilk::future<struct pair_t> *fut;
-    pair_t(volatile pair_t const& other) {
-      this->n = other.n;
-      this->fut = other.fut;
-    }
-    pair_t(pair_t const& other) {
-      this->n = other.n;
-      this->fut = other.fut;
-    }
     pair_t(unsigned long n=0) {
       this->n = n;
       this->fut = NULL;
     }
-    pair_t& operator=(pair_t const& other) volatile {
-      this->n = other.n;
-      this->fut = other.fut;
-      return *(const_cast<pair_t*>(this));
-    }
 } pair_t;
 
 pair_t produce(unsigned long n);
@@ -65,7 +52,7 @@ static unsigned long consume(unsigned long curr_sum, pair_t data) {
 
     if (data.fut != NULL) {
         curr_sum += data.n;
-        pair_t next_data = (pair_t)data.fut->get();
+        pair_t next_data = data.fut->get();
         res = consume(curr_sum, next_data);
         delete data.fut;
     }
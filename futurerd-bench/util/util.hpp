@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
 
 // Ensure that we run serially
 static void ensure_serial_execution(void) {
@@ -19,6 +21,23 @@ static void ensure_serial_execution(void) {
   }
 }
 
+// Print current and peak resident set size, e.g. to see how much
+// memory the runtime holds on to in idle fiber stacks. This goes to
+// stderr so that the timing output scripts parse stays as it was.
+__attribute__((unused)) static
+void print_rss(const char *when) {
+  long pages = 0, resident = 0;
+  FILE *f = fopen("/proc/self/statm", "r");
+  if (f) {
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    fclose(f);
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  fprintf(stderr, "RSS %s: %ld KB (peak %ld KB)\n", when,
+         resident * (sysconf(_SC_PAGESIZE) / 1024), usage.ru_maxrss);
+}
+
 __attribute__((unused)) static
 void gen_rand_string(char * s, int s_length, int range) {
   for(int i = 0; i < s_length; ++i ) {
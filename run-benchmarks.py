@@ -35,10 +35,11 @@ def main():
     parser = argparse.ArgumentParser(description='Run benchmarks and output their results to a file.')
     parser.add_argument('benchmarks', metavar='bench', default=[bench for bench in benchargs.bench_args if True], type=str, nargs='*', help='Which benchmarks to run.')
     parser.add_argument('-l', '--list-targets', dest='list_targets', action='store_const', const=True, default=False, help='List all available benchmarks and exit.')
+    parser.add_argument('-e', '--env', dest='env', action='append', default=[], metavar='VAR=VALUE', help='Set an environment variable for every run, e.g. CILK_PRIORITY_BURST=0. The results files get a matching suffix, so runs with different settings can be compared.')
 
     args = parser.parse_args()
 
-    bench_list = [ bench for bench in benchargs.bench_args if True ]
+    bench_list = [ bench for bench in args.benchmarks if bench in benchargs.bench_args ]
     # Sort in list order to save bintree for last; it is SLOW
     bench_list.sort(reverse=True)
 
@@ -46,6 +47,9 @@ def main():
         print bench_list
         exit(0)
 
+    env_str = ''.join([e + ' ' for e in args.env])
+    results_suffix = ''.join(['_' + e for e in args.env])
+
     bench_groups = dict()
     for bench in bench_list:
         # get the benchmark name
@@ -80,6 +84,8 @@ def main():
 
         header = benchargs.bench_args[bench]['args'].format('<P>', '<P*4>') + '\nrunning times (s):,'
         data = bench + ','
+        # Latency benchmarks print one 'csv,...' line per run
+        latency_data = ''
         
         for ncores in benchargs.core_counts:
             if ('se' in bench):
@@ -95,13 +101,19 @@ def main():
                 nruns = 1 # It is configurable in the benchmark
 
             for i in range(0, nruns):
-                cmd = "taskset -c 0-" + str(ncores-1) + " " + location + " " + benchargs.bench_args[bench]['args'] + nruns_args_str
+                cmd = env_str + "taskset -c 0-" + str(ncores-1) + " " + location + " " + benchargs.bench_args[bench]['args'] + nruns_args_str
+                if ("stream" in bench):
+                    cmd = "CILK_NWORKERS=" + str(ncores) + " " + cmd
                 cmd = cmd.format(ncores, ncores*4)
                 print cmd
                 res = subprocess.Popen(cmd, shell=True, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
                 (stdout, stderr) = res.communicate()
                 print stdout.strip()
 
+                for l in stdout.split('\n'):
+                    if l.startswith('csv,'):
+                        latency_data += l[len('csv,'):] + '\n'
+
                 if ("ferret" in bench):
                     times.append(float(stdout.split()[2]))
                 elif ("bst" in bench):
@@ -145,11 +157,15 @@ def main():
 
         bench_groups[group_key] = bench_groups[group_key] + '\n' + data
         write_grouped_data(bench_groups)
-        with open('bench-results/'+bench+'_timing.csv', 'w') as f:
+        with open('bench-results/'+bench+results_suffix+'_timing.csv', 'w') as f:
             f.write(header)
             f.write('\n')
             f.write(data)
             f.write('\n')
+        if latency_data != '':
+            with open('bench-results/'+bench+results_suffix+'_latency.csv', 'w') as f:
+                f.write('variant,P,rate (req/s),throughput (req/s),p50 (us),p99 (us),p999 (us)\n')
+                f.write(latency_data)
 
 
 if __name__ == "__main__":